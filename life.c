@@ -1,15 +1,83 @@
+#include <ctype.h>
 #include <mpi.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define WIDTH 32  // Width of the grid
-#define HEIGHT 32 // Height of the grid
+#define WIDTH 32  // Default width of the grid, see -size
+#define HEIGHT 32 // Default height of the grid
+#define TILE 8    // Side of the tiles whose changes are tracked
+#define MAX_RADIUS TILE // Largest neighbourhood radius of a rule; a change reaches at most the next tile
+#define MAX_COUNT ((2 * MAX_RADIUS + 1) * (2 * MAX_RADIUS + 1))
 // #define ITERATIONS 10 // This line is commented out or removed
 
-void initializeGrid(int *grid, int width, int height);
+// Board file, the same as life2's: the header, then the rows of the board, (width + 7) / 8
+// bytes each, with cell j of a row in bit j % 8 of byte j / 8
+#define BOARD_MAGIC "LIFEBRD1"
+
+typedef struct
+{
+    char magic[8];
+    int64_t width;
+    int64_t height;
+    int64_t generation; // Generation of the board
+} BoardHeader;
+
+// Outer-totalistic rule, the same as life2's: the next state of a cell is
+// next[2 * count + state], where count is the number of live cells in the square of
+// 2 * radius + 1 cells on a side around it, the cell itself included
+typedef struct
+{
+    int radius;
+    unsigned char next[2 * (MAX_COUNT + 1)];
+} Rule;
+
+// Snapshots go to a dedicated writer process. Rank 0 sends this header, then every
+// computing process its slice.
+typedef struct
+{
+    long long generation;
+    int final;      // The final grid, which ends the run
+    double elapsed; // Time taken, in the final snapshot
+} SnapshotHeader;
+
+// Snapshots in flight from a computing process; one buffer is filled while the other
+// may still be on its way to the writer
+typedef struct
+{
+    int *buffers[2];
+    SnapshotHeader headers[2];
+    MPI_Request requests[2][2]; // Header and slice sent from each buffer
+    int next;                   // Buffer of the next snapshot
+} Snapshots;
+
+// Changes of a slice, tracked in tiles of TILE x TILE cells (the last row and column
+// of tiles may be smaller), so that only the tiles near changes are updated
+typedef struct
+{
+    int tilesY, tilesX;
+    unsigned char *changed;       // Tiles that changed in the last generation
+    unsigned char *changedBefore; // Tiles that changed in the generation before
+} Tiles;
+
+char *parseCounts(const char *text, unsigned char *set);
+int parseRule(const char *text, Rule *rule);
+int sliceStart(int height, int slices, int s);
+void initializeSlice(int *slice, int width, int row0, int rows, unsigned seed);
 void printGrid(int *grid, int width, int height);
-void updateGrid(int *grid, int *newGrid, int width, int height);
+void printSnapshot(int *grid, int width, int height, long long generation);
+void sendSnapshot(Snapshots *snapshots, const int *slice, int width, int rows, MPI_Datatype rowType, int writer,
+                  int rank, long long generation, int final, double elapsed);
+void runWriter(int width, int height, int slices, int size, MPI_Datatype rowType);
+long long readBoard(const char *path, int *width, int *height);
+void accessSlice(const char *path, int *slice, int width, int height, int row0, int rows, long long generation,
+                 int write, MPI_Comm comm);
+void exchangeHalo(int *slice, int width, int height, int halo, const Tiles *tiles, int received[2], MPI_Comm comm);
+int updateMoore(const int *grid, int *newGrid, int width, int i0, int i1, int j0, int j1, const Rule *rule);
+int updateWindow(const int *grid, int *newGrid, int width, int i0, int i1, int j0, int j1, const Rule *rule);
+void updateGrid(int *grid, int *newGrid, int width, int height, const Rule *rule, Tiles *tiles, const int received[2]);
 
 int main(int argc, char **argv)
 {
@@ -22,94 +90,370 @@ int main(int argc, char **argv)
     {
         if (rank == 0)
         {
-            printf("Usage: %s <iterations>\n", argv[0]);
+            printf("Usage: %s <iterations> [-size W H] [-seed S] [-restart FILE] [-checkpoint FILE] [-every K] "
+                   "[-snapshot K] [-print] [-rule RULE]\n",
+                   argv[0]);
             printf("Note: Use 0 for iterations to run indefinitely.\n");
+            printf("The grid is shown every -snapshot K generations (default 1) and at the end; 0 shows no grid,\n");
+            printf("for benchmark runs, unless -print asks for the final grid.\n");
+            printf("Iterations count from the generation of the restart file.\n");
+            printf("-rule takes B/S rules such as B36/S23, and Larger than Life rules such as\n");
+            printf("R5,C0,M1,S33..57,B34..45.\n");
         }
         MPI_Finalize();
         return 1;
     }
 
     int iterations = atoi(argv[1]); // Convert the argument to an integer
+    int width = WIDTH, height = HEIGHT;
+    unsigned seed = (unsigned)time(NULL);
+    const char *restart = NULL;    // Board file to start from
+    const char *checkpoint = NULL; // Board file written every checkpointEvery generations and at the end
+    int checkpointEvery = 0;
+    int snapshotEvery = 1;
+    int print = 0; // Show the final grid even without snapshots
+    const char *ruleText = "B3/S23";
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-size") == 0 && i + 2 < argc)
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+        {
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-restart") == 0 && i + 1 < argc)
+        {
+            restart = argv[++i];
+        }
+        else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc)
+        {
+            checkpoint = argv[++i];
+        }
+        else if (strcmp(argv[i], "-every") == 0 && i + 1 < argc)
+        {
+            checkpointEvery = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-snapshot") == 0 && i + 1 < argc)
+        {
+            snapshotEvery = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-rule") == 0 && i + 1 < argc)
+        {
+            ruleText = argv[++i];
+        }
+        else if (strcmp(argv[i], "-print") == 0)
+        {
+            print = 1;
+        }
+    }
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD); // The clocks of the processes may differ
 
-    int sliceHeight = HEIGHT / size; // Height of each slice
-    int *grid;
-    int *slice = (int *)malloc(WIDTH * sliceHeight * sizeof(int));
-    int *newSlice = (int *)malloc(WIDTH * sliceHeight * sizeof(int));
+    long long generation = 0;
+    if (restart != NULL)
+    {
+        generation = readBoard(restart, &width, &height);
+    }
+    // With snapshots and more than one process, the last process is a dedicated writer, so
+    // that showing the grid stays off the critical path of the others
+    int worldSize = size;
+    int writer = snapshotEvery > 0 && size > 1 ? size - 1 : -1;
+    int slices = writer >= 0 ? size - 1 : size;
+    Rule rule;
+    if (parseRule(ruleText, &rule) != 0)
+    {
+        if (rank == 0)
+        {
+            printf("Cannot parse the rule %s.\n", ruleText);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    // The halo rows of a slice come from the next slice alone
+    int halo = rule.radius;
+    if (width < halo || height < slices * halo || snapshotEvery < 0)
+    {
+        if (rank == 0)
+        {
+            printf("The board needs at least the radius of the rule in columns, and in rows for every process.\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    // Whole rows are sent as one element, so that no count or offset grows with the board area
+    MPI_Datatype rowType;
+    MPI_Type_contiguous(width, MPI_INT, &rowType);
+    MPI_Type_commit(&rowType);
+    MPI_Comm comm; // The computing processes
+    MPI_Comm_split(MPI_COMM_WORLD, rank == writer, rank, &comm);
+    if (rank == writer)
+    {
+        runWriter(width, height, slices, worldSize, rowType);
+        MPI_Type_free(&rowType);
+        MPI_Comm_free(&comm);
+        MPI_Finalize();
+        return 0;
+    }
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
 
-    // Master process initializes the grid and distributes it
-    if (rank == 0)
+    int row0 = sliceStart(height, size, rank);
+    int sliceHeight = sliceStart(height, size, rank + 1) - row0;
+    // Slices have halo rows above and below, as many as the radius of the rule
+    int *slice = (int *)calloc((size_t)width * (sliceHeight + 2 * halo), sizeof(int));
+    int *newSlice = (int *)calloc((size_t)width * (sliceHeight + 2 * halo), sizeof(int));
+
+    // Every tile counts as changed to begin with
+    Tiles tiles;
+    tiles.tilesY = (sliceHeight + TILE - 1) / TILE;
+    tiles.tilesX = (width + TILE - 1) / TILE;
+    tiles.changed = (unsigned char *)malloc(tiles.tilesY * tiles.tilesX);
+    tiles.changedBefore = (unsigned char *)malloc(tiles.tilesY * tiles.tilesX);
+    memset(tiles.changed, 1, tiles.tilesY * tiles.tilesX);
+    memset(tiles.changedBefore, 1, tiles.tilesY * tiles.tilesX);
+
+    // Every process sets up its own slice
+    if (restart != NULL)
+    {
+        accessSlice(restart, slice + (size_t)halo * width, width, height, row0, sliceHeight, generation, 0, comm);
+    }
+    else
     {
-        grid = (int *)malloc(WIDTH * HEIGHT * sizeof(int));
-        initializeGrid(grid, WIDTH, HEIGHT);
+        initializeSlice(slice + (size_t)halo * width, width, row0, sliceHeight, seed);
     }
-    MPI_Scatter(grid, WIDTH * sliceHeight, MPI_INT, slice, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
 
-    double startTime = MPI_Wtime(); // Start timing
+    Snapshots snapshots = {.next = 0}; // The buffers and requests are set up below
+    for (int b = 0; b < 2; b++)
+    {
+        snapshots.buffers[b] = (int *)malloc((size_t)width * sliceHeight * sizeof(int) + 1);
+        snapshots.requests[b][0] = snapshots.requests[b][1] = MPI_REQUEST_NULL;
+    }
 
-    // Inside the main function, modify the simulation loop
+    double startTime = MPI_Wtime(); // Start timing
 
     // Simulation loop
-    int iter = 0;
+    long long iter = generation;
     while (iterations == 0 || iter < iterations)
     {
-        // Update slice
-        updateGrid(slice, newSlice, WIDTH, sliceHeight);
+        // Exchange the edge rows that changed with the neighbouring slices, then update the slice
+        int received[2];
+        exchangeHalo(slice, width, sliceHeight, halo, &tiles, received, comm);
+        updateGrid(slice, newSlice, width, sliceHeight, &rule, &tiles, received);
 
         // Swap pointers for next iteration
         int *temp = slice;
         slice = newSlice;
         newSlice = temp;
 
-        // Gather the slices back to the master process for printing
-        MPI_Gather(slice, WIDTH * sliceHeight, MPI_INT, grid, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
+        // Every process writes its own slice of the checkpoint
+        if (checkpoint != NULL && checkpointEvery > 0 && (iter + 1) % checkpointEvery == 0)
+        {
+            accessSlice(checkpoint, slice + (size_t)halo * width, width, height, row0, sliceHeight, iter + 1, 1,
+                        comm);
+        }
 
-        // Master process prints the grid
-        if (rank == 0)
+        // Hand the slices to the writer, or show the grid of a single process directly
+        if (snapshotEvery > 0 && (iter + 1) % snapshotEvery == 0)
         {
-            system("cls"); // Clear the console for Windows, use "clear" for Linux/Mac
-            printf("Iteration: %d\n", iter + 1);
-            printGrid(grid, WIDTH, HEIGHT);
-            Sleep(1); // Pause for a second (Windows), use sleep(1) for Linux/Mac
+            if (writer >= 0)
+            {
+                sendSnapshot(&snapshots, slice + (size_t)halo * width, width, sliceHeight, rowType, writer, rank,
+                             iter + 1, 0, 0.0);
+            }
+            else
+            {
+                printSnapshot(slice + (size_t)halo * width, width, height, iter + 1);
+            }
         }
 
         // Optionally, redistribute the grid back to all processes if necessary
         // MPI_Scatter(grid, WIDTH * sliceHeight, MPI_INT, slice, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
 
-        if (iterations != 0)
-        {
-            iter++;
-        }
+        iter++;
     }
 
     double endTime = MPI_Wtime(); // End timing
 
-    // Gather the slices back to the master process
-    MPI_Gather(slice, WIDTH * sliceHeight, MPI_INT, grid, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
+    if (checkpoint != NULL)
+    {
+        accessSlice(checkpoint, slice + (size_t)halo * width, width, height, row0, sliceHeight, iter, 1, comm);
+    }
 
-    // Master process prints the final grid and timing information
-    if (rank == 0)
+    if (writer >= 0)
+    {
+        // The writer prints the final grid and timing information
+        sendSnapshot(&snapshots, slice + (size_t)halo * width, width, sliceHeight, rowType, writer, rank, iter, 1,
+                     endTime - startTime);
+        for (int b = 0; b < 2; b++)
+        {
+            MPI_Waitall(2, snapshots.requests[b], MPI_STATUSES_IGNORE);
+        }
+    }
+    else
     {
-        printf("Final grid:\n");
-        printGrid(grid, WIDTH, HEIGHT);
-        printf("Number of processes: %d\n", size);
-        printf("Time taken: %f seconds\n", endTime - startTime);
-        free(grid);
+        // Without a writer, the master process gathers the grid only to show it; the
+        // checkpoint file is the way to keep the final grid of a large board
+        if (print || snapshotEvery > 0)
+        {
+            int *grid = NULL, *counts = NULL, *displs = NULL;
+            if (rank == 0)
+            {
+                grid = (int *)malloc((size_t)width * height * sizeof(int));
+                counts = (int *)malloc(size * sizeof(int));
+                displs = (int *)malloc(size * sizeof(int));
+                for (int s = 0; s < size; s++)
+                {
+                    displs[s] = sliceStart(height, size, s);
+                    counts[s] = sliceStart(height, size, s + 1) - displs[s];
+                }
+            }
+            MPI_Gatherv(slice + (size_t)halo * width, sliceHeight, rowType, grid, counts, displs, rowType, 0, comm);
+            if (rank == 0)
+            {
+                printf("Final grid:\n");
+                printGrid(grid, width, height);
+                free(grid);
+                free(counts);
+                free(displs);
+            }
+        }
+
+        // Master process prints the timing information
+        if (rank == 0)
+        {
+            printf("Number of processes: %d\n", worldSize);
+            printf("Time taken: %f seconds\n", endTime - startTime);
+        }
     }
 
+    free(snapshots.buffers[0]);
+    free(snapshots.buffers[1]);
+    MPI_Type_free(&rowType);
+    MPI_Comm_free(&comm);
     free(slice);
     free(newSlice);
+    free(tiles.changed);
+    free(tiles.changedBefore);
     MPI_Finalize();
     return 0;
 }
 
-void initializeGrid(int *grid, int width, int height)
+// Read a count or a range of counts such as 33..57 into set. Returns the end of it, or
+// NULL if there is none.
+char *parseCounts(const char *text, unsigned char *set)
 {
-    srand(time(NULL)); // Seed the random number generator
-    for (int i = 0; i < height; i++)
+    char *end;
+    long low = strtol(text, &end, 10), high = low;
+    if (end == text)
+        return NULL;
+    if (strncmp(end, "..", 2) == 0)
+    {
+        text = end + 2;
+        high = strtol(text, &end, 10);
+        if (end == text)
+            return NULL;
+    }
+    if (low < 0 || high < low || high > MAX_COUNT)
+        return NULL;
+    for (long n = low; n <= high; n++)
+        set[n] = 1;
+    return end;
+}
+
+// Parse a rulestring, as life2 does. B/S rules list the neighbour counts a dead cell is
+// born with and a live cell survives with, as in B36/S23. Larger than Life rules are
+// comma separated fields: R the radius, C the number of states (2, or 0 for the same),
+// M 1 if a cell counts itself, S and B ranges of counts, and N the neighbourhood, which
+// must be M (Moore). Returns 0, or -1 if the rule is not understood.
+int parseRule(const char *text, Rule *rule)
+{
+    unsigned char born[MAX_COUNT + 1] = {0}, survive[MAX_COUNT + 1] = {0};
+    int radius = 1, middle = 0;
+    if (strchr(text, ',') == NULL)
+    {
+        unsigned char *set = NULL;
+        for (const char *c = text; *c != '\0'; c++)
+        {
+            if (toupper((unsigned char)*c) == 'B')
+                set = born;
+            else if (toupper((unsigned char)*c) == 'S')
+                set = survive;
+            else if (*c == '/')
+                set = NULL;
+            else if (set != NULL && *c >= '0' && *c <= '8')
+                set[*c - '0'] = 1;
+            else
+                return -1;
+        }
+    }
+    else
+    {
+        const char *field = text;
+        for (;;)
+        {
+            char letter = (char)toupper((unsigned char)*field++);
+            char *end;
+            long value = strtol(field, &end, 10);
+            if (letter == 'S' || letter == 'B')
+            {
+                end = parseCounts(field, letter == 'S' ? survive : born);
+            }
+            else if (letter == 'N')
+            {
+                end = toupper((unsigned char)*field) == 'M' ? (char *)field + 1 : NULL;
+            }
+            else if (end == field || !((letter == 'R' && value >= 1 && value <= MAX_RADIUS) ||
+                                        (letter == 'C' && (value == 0 || value == 2)) ||
+                                        (letter == 'M' && (value == 0 || value == 1))))
+            {
+                return -1;
+            }
+            if (end == NULL || (*end != ',' && *end != '\0'))
+                return -1;
+            if (letter == 'R')
+                radius = (int)value;
+            if (letter == 'M')
+                middle = (int)value;
+            if (*end == '\0')
+                break;
+            field = end + 1;
+        }
+    }
+
+    // The counts of the rule leave out the cell itself unless M1 says otherwise
+    int side = 2 * radius + 1;
+    rule->radius = radius;
+    for (int count = 0; count <= side * side; count++)
+    {
+        for (int state = 0; state <= 1; state++)
+        {
+            int n = middle ? count : count - state;
+            rule->next[2 * count + state] = n >= 0 && (state ? survive[n] : born[n]);
+        }
+    }
+    return 0;
+}
+
+// First row of slice s of the grid; the first height % slices slices get one more row
+int sliceStart(int height, int slices, int s)
+{
+    return s * (height / slices) + (s < height % slices ? s : height % slices);
+}
+
+// Randomly initialize the rows row0..row0 + rows - 1 of the grid. Each cell depends only on
+// the seed and its position, as in life2, so the grid is the same for any number of processes.
+void initializeSlice(int *slice, int width, int row0, int rows, unsigned seed)
+{
+    for (int i = 0; i < rows; i++)
     {
         for (int j = 0; j < width; j++)
         {
-            grid[i * width + j] = rand() % 2; // Randomly initialize cells as alive (1) or dead (0)
+            uint64_t x = ((uint64_t)(row0 + i) * width + j) + ((uint64_t)seed << 40);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull; // splitmix64 finalizer
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            slice[(size_t)i * width + j] = (int)((x ^ (x >> 31)) >> 63); // Alive (1) or dead (0)
         }
     }
 }
@@ -120,46 +464,304 @@ void printGrid(int *grid, int width, int height)
     {
         for (int j = 0; j < width; j++)
         {
-            printf("%c ", grid[i * width + j] ? 'X' : '.'); // Print 'X' for alive cells, '.' for dead
+            printf("%c ", grid[(size_t)i * width + j] ? 'X' : '.'); // Print 'X' for alive cells, '.' for dead
         }
         printf("\n");
     }
 }
 
-void updateGrid(int *grid, int *newGrid, int width, int height)
+// Send the top and bottom halo rows of the slice to the slices above and below, which
+// wrap around, if a tile on them changed in one of the last two generations (the halo
+// rows of this generation's buffer were last filled two generations ago), and as an
+// empty message otherwise, so each neighbour learns whether its halo rows were filled
+// from the size of the one message it receives. received[0] and received[1] say
+// whether the halo rows above and below were filled.
+void exchangeHalo(int *slice, int width, int height, int halo, const Tiles *tiles, int received[2], MPI_Comm comm)
 {
-    for (int i = 0; i < height; i++)
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int above = (rank - 1 + size) % size;
+    int below = (rank + 1) % size;
+    int sent[2] = {0, 0};
+    for (int a = 0; a < tiles->tilesY; a++)
     {
-        for (int j = 0; j < width; j++)
+        for (int b = 0; b < tiles->tilesX; b++)
+        {
+            int changed = tiles->changed[a * tiles->tilesX + b] | tiles->changedBefore[a * tiles->tilesX + b];
+            if (a * TILE < halo)
+                sent[0] |= changed;
+            if ((a + 1) * TILE > height - halo) // The last row of tiles may have fewer than halo rows
+                sent[1] |= changed;
+        }
+    }
+
+    MPI_Request requests[4];
+    MPI_Status statuses[4];
+    MPI_Irecv(slice, halo * width, MPI_INT, above, 3, comm, &requests[0]);
+    MPI_Irecv(slice + (size_t)(height + halo) * width, halo * width, MPI_INT, below, 2, comm, &requests[1]);
+    MPI_Isend(slice + (size_t)halo * width, sent[0] ? halo * width : 0, MPI_INT, above, 2, comm, &requests[2]);
+    MPI_Isend(slice + (size_t)height * width, sent[1] ? halo * width : 0, MPI_INT, below, 3, comm, &requests[3]);
+    MPI_Waitall(4, requests, statuses);
+    for (int side = 0; side < 2; side++)
+    {
+        int count;
+        MPI_Get_count(&statuses[side], MPI_INT, &count);
+        received[side] = count > 0;
+    }
+}
+
+// Kernel of radius 1: the 3 x 3 square of each cell in rows i0..i1 and columns j0..j1 is
+// added up directly, and the rule looks the next state up. Returns whether any changed.
+int updateMoore(const int *grid, int *newGrid, int width, int i0, int i1, int j0, int j1, const Rule *rule)
+{
+    int changed = 0;
+    for (int i = i0; i <= i1; i++)
+    {
+        const int *up = grid + (size_t)(i - 1) * width, *mid = grid + (size_t)i * width;
+        const int *down = grid + (size_t)(i + 1) * width;
+        for (int j = j0; j <= j1; j++)
+        {
+            int left = j == 0 ? width - 1 : j - 1; // Wrap around edges
+            int right = j == width - 1 ? 0 : j + 1;
+            int count = up[left] + up[j] + up[right] + mid[left] + mid[j] + mid[right] + down[left] + down[j] +
+                        down[right];
+            newGrid[(size_t)i * width + j] = rule->next[2 * count + mid[j]];
+            changed |= newGrid[(size_t)i * width + j] != mid[j];
+        }
+    }
+    return changed;
+}
+
+// Kernel of larger radii r: the sums of the 2r + 1 rows around a row are kept for each
+// column and moved down a row at a time, and the square of each cell is a running sum
+// of 2r + 1 of them moved along the row, so a cell costs the same at any radius
+int updateWindow(const int *grid, int *newGrid, int width, int i0, int i1, int j0, int j1, const Rule *rule)
+{
+    int r = rule->radius, columns = j1 - j0 + 1 + 2 * r, changed = 0;
+    int cols[TILE + 2 * MAX_RADIUS], sums[TILE + 2 * MAX_RADIUS]; // Columns j0 - r..j1 + r, wrapped around
+    for (int k = 0; k < columns; k++)
+    {
+        cols[k] = (j0 - r + k + width) % width;
+        sums[k] = 0;
+        for (int i = i0 - r; i <= i0 + r; i++)
+            sums[k] += grid[(size_t)i * width + cols[k]];
+    }
+    for (int i = i0; i <= i1; i++)
+    {
+        if (i > i0)
+        {
+            const int *enter = grid + (size_t)(i + r) * width, *leave = grid + (size_t)(i - r - 1) * width;
+            for (int k = 0; k < columns; k++)
+                sums[k] += enter[cols[k]] - leave[cols[k]];
+        }
+        int count = 0;
+        for (int k = 0; k < 2 * r; k++)
+            count += sums[k];
+        for (int j = j0, k = 0; j <= j1; j++, k++)
+        {
+            count += sums[k + 2 * r];
+            size_t cell = (size_t)i * width + j;
+            newGrid[cell] = rule->next[2 * count + grid[cell]];
+            changed |= newGrid[cell] != grid[cell];
+            count -= sums[k];
+        }
+    }
+    return changed;
+}
+
+// Update the rows of the slice between its halo rows, which are rows halo..halo + height - 1
+// of the grid. A tile is updated only if it or a tile next to it changed in the last
+// generation, or if it borders halo rows that were received; the others are the same in
+// both buffers already. The kernel is picked once per tile by the radius of the rule.
+void updateGrid(int *grid, int *newGrid, int width, int height, const Rule *rule, Tiles *tiles, const int received[2])
+{
+    int halo = rule->radius;
+    // A change reaches two columns of tiles along if the last one, which wraps around to
+    // the first, is narrower than the radius
+    int reach = width % TILE != 0 && width % TILE < halo ? 2 : 1;
+    for (int a = 0; a < tiles->tilesY; a++)
+    {
+        for (int b = 0; b < tiles->tilesX; b++)
         {
-            int aliveNeighbors = 0;
-            // Check all eight neighbors
+            int active = (a * TILE < halo && received[0]) || ((a + 1) * TILE > height - halo && received[1]);
             for (int y = -1; y <= 1; y++)
             {
-                for (int x = -1; x <= 1; x++)
+                for (int x = -reach; x <= reach; x++)
                 {
-                    if (x == 0 && y == 0)
-                        continue;                       // Skip the cell itself
-                    int ni = (i + y + height) % height; // Wrap around edges
-                    int nj = (j + x + width) % width;
-                    aliveNeighbors += grid[ni * width + nj];
+                    int ta = a + y;
+                    int tb = ((b + x) % tiles->tilesX + tiles->tilesX) % tiles->tilesX; // Columns wrap around
+                    if (ta >= 0 && ta < tiles->tilesY)
+                        active |= tiles->changed[ta * tiles->tilesX + tb];
                 }
             }
-            // Apply the Game of Life rules
-            if (grid[i * width + j] == 1 && (aliveNeighbors < 2 || aliveNeighbors > 3))
+
+            int changed = 0;
+            if (active)
             {
-                newGrid[i * width + j] = 0; // Cell dies
+                int i0 = halo + a * TILE, i1 = halo + (height < (a + 1) * TILE ? height : (a + 1) * TILE) - 1;
+                int j0 = b * TILE, j1 = (width < (b + 1) * TILE ? width : (b + 1) * TILE) - 1;
+                if (halo == 1)
+                    changed = updateMoore(grid, newGrid, width, i0, i1, j0, j1, rule);
+                else
+                    changed = updateWindow(grid, newGrid, width, i0, i1, j0, j1, rule);
             }
-            else if (grid[i * width + j] == 0 && aliveNeighbors == 3)
+            tiles->changedBefore[a * tiles->tilesX + b] = changed; // Becomes the new changed below
+        }
+    }
+
+    unsigned char *temp = tiles->changed;
+    tiles->changed = tiles->changedBefore;
+    tiles->changedBefore = temp;
+}
+
+// Clear the terminal and show the grid of a generation. The escape sequence works in
+// Linux, macOS and Windows 10 terminals alike.
+void printSnapshot(int *grid, int width, int height, long long generation)
+{
+    printf("\033[H\033[2J");
+    printf("Iteration: %lld\n", generation);
+    printGrid(grid, width, height);
+    fflush(stdout);
+}
+
+// Hand a copy of the slice to the writer without waiting for it to arrive. Only the
+// snapshot before last must have been received before its buffer is reused.
+void sendSnapshot(Snapshots *snapshots, const int *slice, int width, int rows, MPI_Datatype rowType, int writer,
+                  int rank, long long generation, int final, double elapsed)
+{
+    int b = snapshots->next;
+    MPI_Waitall(2, snapshots->requests[b], MPI_STATUSES_IGNORE);
+    memcpy(snapshots->buffers[b], slice, (size_t)width * rows * sizeof(int));
+    if (rank == 0)
+    {
+        SnapshotHeader header = {generation, final, elapsed};
+        snapshots->headers[b] = header;
+        MPI_Isend(&snapshots->headers[b], sizeof(SnapshotHeader), MPI_BYTE, writer, 0, MPI_COMM_WORLD,
+                  &snapshots->requests[b][0]);
+    }
+    MPI_Isend(snapshots->buffers[b], rows, rowType, writer, 1, MPI_COMM_WORLD, &snapshots->requests[b][1]);
+    snapshots->next = !b;
+}
+
+// The dedicated writer: collects the slices of each snapshot into the grid and shows it,
+// until the final grid arrives with the time taken
+void runWriter(int width, int height, int slices, int size, MPI_Datatype rowType)
+{
+    int *grid = (int *)malloc((size_t)width * height * sizeof(int));
+    MPI_Request *requests = (MPI_Request *)malloc(slices * sizeof(MPI_Request));
+    SnapshotHeader header;
+    do
+    {
+        MPI_Recv(&header, sizeof(header), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        for (int s = 0; s < slices; s++)
+        {
+            int row0 = sliceStart(height, slices, s);
+            int rows = sliceStart(height, slices, s + 1) - row0;
+            MPI_Irecv(grid + (size_t)row0 * width, rows, rowType, s, 1, MPI_COMM_WORLD, &requests[s]);
+        }
+        MPI_Waitall(slices, requests, MPI_STATUSES_IGNORE);
+
+        if (!header.final)
+        {
+            printSnapshot(grid, width, height, header.generation);
+        }
+    } while (!header.final);
+
+    printf("Final grid:\n");
+    printGrid(grid, width, height);
+    printf("Number of processes: %d\n", size);
+    printf("Time taken: %f seconds\n", header.elapsed);
+    free(grid);
+    free(requests);
+}
+
+// Every process reads the header of a board file; returns its generation and sets the board size
+long long readBoard(const char *path, int *width, int *height)
+{
+    BoardHeader header;
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_read_at_all(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    if (memcmp(header.magic, BOARD_MAGIC, 8) != 0 || header.width <= 0 || header.width > INT32_MAX ||
+        header.height <= 0 || header.height > INT32_MAX || header.generation < 0)
+    {
+        fprintf(stderr, "%s is not a board file\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    *width = (int)header.width;
+    *height = (int)header.height;
+    return header.generation;
+}
+
+// Collective read or write of rows row0..row0 + rows - 1 of a board file, each process its own
+// slice. The rows of a slice are contiguous in the file. A checkpoint is written under a
+// temporary name and renamed once complete, so a crash while writing leaves the last one intact.
+void accessSlice(const char *path, int *slice, int width, int height, int row0, int rows, long long generation,
+                 int write, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    char tempPath[4096];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+    MPI_File fh;
+    int amode = write ? MPI_MODE_CREATE | MPI_MODE_WRONLY : MPI_MODE_RDONLY;
+    if (MPI_File_open(comm, write ? tempPath : path, amode, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot open %s\n", write ? tempPath : path);
+        MPI_Abort(comm, 1);
+    }
+
+    int rowBytes = (width + 7) / 8;
+    MPI_Offset offset = sizeof(BoardHeader) + (MPI_Offset)row0 * rowBytes;
+    unsigned char *bytes = (unsigned char *)calloc((size_t)rows * rowBytes + 1, 1);
+    MPI_Datatype rowType; // A row of the file, so that the count is in rows
+    MPI_Type_contiguous(rowBytes, MPI_BYTE, &rowType);
+    MPI_Type_commit(&rowType);
+    if (write)
+    {
+        MPI_File_set_size(fh, sizeof(BoardHeader) + (MPI_Offset)height * rowBytes);
+        if (rank == 0)
+        {
+            BoardHeader header = {BOARD_MAGIC, width, height, generation};
+            MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < width; j++)
             {
-                newGrid[i * width + j] = 1; // Cell becomes alive
+                bytes[(size_t)i * rowBytes + j / 8] |= (slice[(size_t)i * width + j] != 0) << (j % 8);
             }
-            else
+        }
+        MPI_File_write_at_all(fh, offset, bytes, rows, rowType, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        MPI_File_read_at_all(fh, offset, bytes, rows, rowType, MPI_STATUS_IGNORE);
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < width; j++)
             {
-                newGrid[i * width + j] = grid[i * width + j]; // No change
+                slice[(size_t)i * width + j] = bytes[(size_t)i * rowBytes + j / 8] >> (j % 8) & 1;
             }
         }
     }
+    free(bytes);
+    MPI_Type_free(&rowType);
+    MPI_File_close(&fh);
+
+    if (write && rank == 0 && rename(tempPath, path) != 0)
+    {
+        fprintf(stderr, "Cannot rename %s to %s\n", tempPath, path);
+        MPI_Abort(comm, 1);
+    }
+    MPI_Barrier(comm);
 }
 
 // a parallel implementation of the Conway's Game of Life using MPI. This example demonstrates the use of parallel computing to simulate a cellular automaton on a distributed system. The Game of Life is a zero-player game, meaning its evolution is determined by its initial state, requiring no further input. It consists of a grid of cells that can live, die, or multiply based on a set of rules.
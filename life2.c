@@ -1,15 +1,163 @@
+#include <ctype.h>
 #include <mpi.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define WIDTH 32
+#define WIDTH 32          // Default board size, see -size
 #define HEIGHT 32
-#define ITERATIONS 100000 // Fixed number of iterations
+#define ITERATIONS 100000 // Default number of generations
+#define MAX_HALO 16        // Deepest halo considered by -halo auto
+#define MAX_RADIUS 16      // Largest neighbourhood radius of a rule
+#define MAX_COUNT ((2 * MAX_RADIUS + 1) * (2 * MAX_RADIUS + 1))
 
-void initializeGrid(int *grid, int width, int height);
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Board file: the header, then the rows of the board, (width + 7) / 8 bytes each, with
+// cell j of a row in bit j % 8 of byte j / 8
+#define BOARD_MAGIC "LIFEBRD1"
+
+typedef struct {
+    char magic[8];
+    int64_t width;
+    int64_t height;
+    int64_t generation; // Generation of the board
+} BoardHeader;
+
+// Outer-totalistic rule, parsed once from a rulestring: the next state of a cell is
+// next[2 * count + state], where count is the number of live cells in the square of
+// 2 * radius + 1 cells on a side around it, the cell itself included. The kernels
+// only look the state up, whatever the rule.
+typedef struct {
+    int radius;
+    int life;                        // B3/S23, which the packed engine has its own kernel for
+    uint8_t next[2 * (MAX_COUNT + 1)];
+    uint64_t masks[2][9];            // Radius 1: all ones where a dead or live cell with 0..8 live neighbours lives
+} Rule;
+
+// A run of the simulation, whichever the engine
+typedef struct {
+    int width, height;
+    long long generation;      // Generation of the starting board
+    long long iterations;      // Generation to stop at
+    unsigned seed;             // Seed of the random starting board
+    const char *restart;       // Board file to start from instead, or NULL
+    const char *checkpoint;    // Board file to write, or NULL
+    long long checkpointEvery; // Generations between checkpoints, 0 for only the last
+    int print;                 // Print the final board, for small boards
+    Rule rule;
+} Run;
+
+// The part of the board held by a process. Regions split rows only at multiples of 8
+// cells, so no two of them share a byte of a board file.
+typedef struct {
+    int row0, rows;
+    int col0, cols;
+    int *cells; // Cell (i, j) of the region is cells[i * ld + j]
+    int ld;
+} Region;
+
+// Packed engine: one bit per cell, 64 cells per word. Each row is stored as a ghost
+// word, the cell words, and a spare word, so the horizontal wraparound can be set up
+// in place and every cell word has a word on either side.
+#define LANES 8 // Words updated together by the vector loop (512 bits)
+
+#if defined(__GNUC__)
+typedef uint64_t Lanes __attribute__((vector_size(LANES * sizeof(uint64_t))));
+#endif
+
+// Cells engine: the board is split into 2D blocks over a periodic Cartesian grid of
+// processes. Each block is stored with a halo frame, filled from the eight
+// neighbouring blocks (four edges and four corners). With a frame one cell deep the
+// halo is exchanged every generation, with a deeper one every halo generations. The
+// two generations of the block and the persistent requests exchanging the halo of
+// each are set up once. With tiles, only the parts of the block near changes are
+// updated, and only the sides of the halo that changed are sent.
+typedef struct {
+    MPI_Comm cart;
+    int rows, cols;              // Cells in the block
+    int row0, col0;              // Position of the block on the board
+    const Rule *rule;
+    int halo;                    // Depth of the halo frame, a multiple of the radius of the rule
+    int stride;                  // cols + 2 * halo
+    int neighbors[8];            // Ranks in the directions of blockDirections
+    MPI_Datatype shapes[8];      // Edge or corner in each direction
+    int sendOffset[8];           // Block cells sent towards each direction
+    int recvOffset[8];           // Halo cells filled from each direction
+    int *cells[2];               // Current and next generation, (rows + 2 * halo) x stride each
+    int *sums;                   // Column sums of the kernel for larger radii, stride of them
+    MPI_Request exchange[2][16]; // Halo receives and sends of each generation buffer
+    int tile;                    // Side of the tiles, 0 without tiles
+    int tilesY, tilesX;          // Tiles in the block
+    uint8_t *changed;            // Tiles that changed in the last generation
+    uint8_t *changedBefore;      // Tiles that changed in the generation before
+    int sendFlags[8];            // Whether each side of the block is sent
+    int recvFlags[8];            // Whether each side of the halo is received
+    MPI_Request skipSends[8];    // Empty messages sent in place of the unchanged sides
+} Block;
+
+// Directions as (row, column) steps: N, S, W, E, NW, SE, NE, SW. Opposite directions
+// are paired, so the opposite of direction d is d ^ 1.
+static const int blockDirections[8][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {1, 1}, {-1, 1}, {1, -1}};
+
+// HashLife engine: the board is a quadtree whose nodes are hash-consed, so every
+// square of cells that occurs anywhere, at any generation, is a single node. Each node
+// remembers its centre half some power of two generations later, which makes
+// repeating patterns cheap to advance by large steps.
+typedef struct Node {
+    struct Node *nw, *ne, *sw, *se; // Quadrants, NULL for a single cell
+    struct Node *next;              // Next node in the same hash bucket
+    struct Node *result;            // Centre half 2^resultStep generations later
+    int level;                      // 2^level cells on a side
+    int resultStep;                 // -1 while there is no result
+    int alive;                      // State of a single cell
+    int marked;                     // Reached by the garbage collector
+} Node;
+
+typedef struct {
+    Node **buckets;
+    size_t bucketCount;
+    size_t nodeCount;
+    size_t maxNodes;     // Collect garbage above this many nodes
+    size_t collectAbove; // maxNodes, or more while the nodes in use fill most of it
+    int collections;
+    Node **roots;        // Nodes the steps in progress still need, which are kept
+    size_t rootCount, rootCapacity;
+    const Rule *rule;
+    Node cells[2];     // Dead and live single cells, which are not in the table
+} HashLife;
+
+int parseRule(const char *text, Rule *rule);
+void seedRegion(const Region *region, int width, unsigned seed);
+void readBoardHeader(const char *path, BoardHeader *header);
+void startRegion(const Run *run, const Region *region);
+int checkpointDue(const Run *run, long long generation);
+void writeCheckpoint(const Run *run, const Region *region, long long generation);
+void finishRun(const Run *run, const Region *region, double elapsed);
 void printGrid(int *grid, int width, int height);
-void updateGrid(int *grid, int *newGrid, int width, int height, int rank, int size);
+void blockCreate(Block *block, const int dims[2], const Run *run, int halo);
+void blockFree(Block *block);
+void blockExchange(Block *block, int current);
+int updateRegion(const Block *block, int current, int row0, int row1, int col0, int col1);
+void updateBlock(Block *block, int current, int step, int overlap);
+void blockTiles(Block *block, int tile);
+void updateTiles(Block *block, int current);
+int chooseHalo(const Run *run, const int dims[2], int rank);
+void runCells(const Run *run, int dims[2], int halo, int overlap, int tile, int rank);
+void packGrid(const int *grid, uint64_t *packed, int width, int height);
+void unpackGrid(const uint64_t *packed, int *grid, int width, int height);
+void updatePacked(uint64_t *packed, uint64_t *newPacked, int width, int height, const Rule *rule, int rank, int size);
+void runPacked(const Run *run, int rank, int size);
+Node *hashNode(HashLife *life, Node *nw, Node *ne, Node *sw, Node *se);
+Node *buildNode(HashLife *life, const int *grid, int width, int height, int x, int y, int level);
+void readNode(const Node *node, int *grid, int width, int height, int x, int y);
+Node *successor4x4(HashLife *life, const Node *node);
+Node *successor(HashLife *life, Node *node, int step);
+void collectGarbage(HashLife *life);
+void runHashLife(const Run *run, size_t cacheBytes, int rank);
 
 int main(int argc, char **argv) {
     int rank, size;
@@ -17,54 +165,327 @@ int main(int argc, char **argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    int sliceHeight = HEIGHT / size;
-    int *grid;
-    int *slice = (int *)malloc(WIDTH * sliceHeight * sizeof(int));
-    int *newSlice = (int *)malloc(WIDTH * sliceHeight * sizeof(int));
+    // Options: -engine cells|packed|hashlife, -size W H, -iterations N, -seed S, -restart FILE,
+    // -checkpoint FILE, -every K, -print, -dims PY PX, -exchange wait|overlap, -halo K|auto,
+    // -tiles T, -cache MB, -rule RULE
+    Run run = {.width = WIDTH, .height = HEIGHT, .iterations = ITERATIONS, .seed = (unsigned)time(NULL)};
+    const char *engine = "cells";
+    const char *exchange = "overlap";
+    const char *rule = "B3/S23";
+    int halo = 1; // Generations between halo exchanges of the cells engine, chosen by chooseHalo if 0
+    int tile = 0; // Tile side of the cells engine, 0 to update every cell
+    size_t cacheMegabytes = 256; // Node cache of the HashLife engine
+    int dims[2] = {0, 0}; // Process grid of the cells engine, chosen by MPI_Dims_create if 0
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-print") == 0) run.print = 1;
+        else if (strcmp(argv[i], "-engine") == 0 && i + 1 < argc) engine = argv[++i];
+        else if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc) run.iterations = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) run.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-restart") == 0 && i + 1 < argc) run.restart = argv[++i];
+        else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) run.checkpoint = argv[++i];
+        else if (strcmp(argv[i], "-every") == 0 && i + 1 < argc) run.checkpointEvery = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-exchange") == 0 && i + 1 < argc) exchange = argv[++i];
+        else if (strcmp(argv[i], "-rule") == 0 && i + 1 < argc) rule = argv[++i];
+        else if (strcmp(argv[i], "-halo") == 0 && i + 1 < argc) {
+            i++;
+            halo = strcmp(argv[i], "auto") == 0 ? 0 : atoi(argv[i]);
+        } else if (strcmp(argv[i], "-tiles") == 0 && i + 1 < argc) tile = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) cacheMegabytes = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            run.width = atoi(argv[++i]);
+            run.height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-dims") == 0 && i + 2 < argc) {
+            dims[0] = atoi(argv[++i]);
+            dims[1] = atoi(argv[++i]);
+        }
+    }
 
-    if (rank == 0) {
-        grid = (int *)malloc(WIDTH * HEIGHT * sizeof(int));
-        initializeGrid(grid, WIDTH, HEIGHT);
+    // A restarted run takes the board size and generation from the file
+    if (run.restart != NULL) {
+        BoardHeader header;
+        readBoardHeader(run.restart, &header);
+        run.width = (int)header.width;
+        run.height = (int)header.height;
+        run.generation = header.generation;
     }
 
-    MPI_Scatter(grid, WIDTH * sliceHeight, MPI_INT, slice, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
+    int packed = strcmp(engine, "packed") == 0;
+    int hashlife = strcmp(engine, "hashlife") == 0;
+    int overlap = strcmp(exchange, "overlap") == 0;
+    if ((!packed && !hashlife && strcmp(engine, "cells") != 0) || (!overlap && strcmp(exchange, "wait") != 0) ||
+        run.width <= 0 || run.height <= 0 || run.iterations < run.generation || run.checkpointEvery < 0 ||
+        halo < 0 || tile < 0 || parseRule(rule, &run.rule) != 0 || ((packed || hashlife) && run.rule.radius != 1) ||
+        MPI_Dims_create(size, 2, dims) != MPI_SUCCESS) {
+        if (rank == 0) {
+            printf("Usage: %s [-engine cells|packed|hashlife] [-size W H] [-iterations N] [-seed S] [-restart FILE] "
+                   "[-checkpoint FILE] [-every K] [-print] [-dims PY PX] [-exchange wait|overlap] [-halo K|auto] "
+                   "[-tiles T] [-cache MB] [-rule RULE]\n",
+                   argv[0]);
+            printf("-iterations is the generation to stop at, also when restarting.\n");
+            printf("-rule takes B/S rules such as B36/S23, and Larger than Life rules such as\n");
+            printf("R5,C0,M1,S33..57,B34..45, which only the cells engine runs.\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
 
-    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before starting the timer
-    double startTime = MPI_Wtime();
+    if (packed) runPacked(&run, rank, size);
+    else if (hashlife) runHashLife(&run, cacheMegabytes << 20, rank);
+    else runCells(&run, dims, halo, overlap, tile, rank);
 
-    for (int iter = 0; iter < ITERATIONS; iter++) {
-        updateGrid(slice, newSlice, WIDTH, sliceHeight, rank, size);
+    MPI_Finalize();
+    return 0;
+}
 
-        int *temp = slice;
-        slice = newSlice;
-        newSlice = temp;
+// First cell of part p of n cells split into parts nearly equal parts
+static int blockStart(int n, int parts, int p) {
+    return (int)((long long)n * p / parts);
+}
+
+// Read a count or a range of counts such as 33..57 into set. Returns the end of it, or
+// NULL if there is none.
+static char *parseCounts(const char *text, uint8_t *set) {
+    char *end;
+    long low = strtol(text, &end, 10), high = low;
+    if (end == text) return NULL;
+    if (strncmp(end, "..", 2) == 0) {
+        text = end + 2;
+        high = strtol(text, &end, 10);
+        if (end == text) return NULL;
     }
+    if (low < 0 || high < low || high > MAX_COUNT) return NULL;
+    for (long n = low; n <= high; n++) set[n] = 1;
+    return end;
+}
 
-    MPI_Gather(slice, WIDTH * sliceHeight, MPI_INT, grid, WIDTH * sliceHeight, MPI_INT, 0, MPI_COMM_WORLD);
+// Parse a rulestring. B/S rules list the neighbour counts a dead cell is born with and
+// a live cell survives with, as in B36/S23. Larger than Life rules are comma separated
+// fields: R the radius, C the number of states (2, or 0 for the same), M 1 if a cell
+// counts itself, S and B ranges of counts, and N the neighbourhood, which must be M
+// (Moore). Returns 0, or -1 if the rule is not understood.
+int parseRule(const char *text, Rule *rule) {
+    uint8_t born[MAX_COUNT + 1] = {0}, survive[MAX_COUNT + 1] = {0};
+    int radius = 1, middle = 0;
+    if (strchr(text, ',') == NULL) {
+        uint8_t *set = NULL;
+        for (const char *c = text; *c != '\0'; c++) {
+            if (toupper((unsigned char)*c) == 'B') set = born;
+            else if (toupper((unsigned char)*c) == 'S') set = survive;
+            else if (*c == '/') set = NULL;
+            else if (set != NULL && *c >= '0' && *c <= '8') set[*c - '0'] = 1;
+            else return -1;
+        }
+    } else {
+        const char *field = text;
+        for (;;) {
+            char letter = (char)toupper((unsigned char)*field++);
+            char *end;
+            long value = strtol(field, &end, 10);
+            if (letter == 'S' || letter == 'B') {
+                end = parseCounts(field, letter == 'S' ? survive : born);
+            } else if (letter == 'N') {
+                end = toupper((unsigned char)*field) == 'M' ? (char *)field + 1 : NULL;
+            } else if (end == field || !((letter == 'R' && value >= 1 && value <= MAX_RADIUS) ||
+                                         (letter == 'C' && (value == 0 || value == 2)) ||
+                                         (letter == 'M' && (value == 0 || value == 1)))) {
+                return -1;
+            }
+            if (end == NULL || (*end != ',' && *end != '\0')) return -1;
+            if (letter == 'R') radius = (int)value;
+            if (letter == 'M') middle = (int)value;
+            if (*end == '\0') break;
+            field = end + 1;
+        }
+    }
 
-    double endTime = MPI_Wtime();
+    // The counts of the rule leave out the cell itself unless M1 says otherwise
+    int side = 2 * radius + 1;
+    rule->radius = radius;
+    for (int count = 0; count <= side * side; count++) {
+        for (int state = 0; state <= 1; state++) {
+            int n = middle ? count : count - state;
+            rule->next[2 * count + state] = n >= 0 && (state ? survive[n] : born[n]);
+        }
+    }
+    rule->life = radius == 1 && !middle;
+    for (int n = 0; n <= 8; n++) {
+        rule->life &= born[n] == (n == 3) && survive[n] == (n == 2 || n == 3);
+        for (int state = 0; state <= 1 && radius == 1; state++) {
+            rule->masks[state][n] = rule->next[2 * (n + state) + state] ? ~UINT64_C(0) : 0;
+        }
+    }
+    return 0;
+}
 
-    if (rank == 0) {
-        printGrid(grid, WIDTH, HEIGHT); // Print final grid
-        printf("Number of processes: %d\n", size);
-        printf("Execution time: %f seconds\n", endTime - startTime);
-        free(grid);
+// Random cell states that depend only on the seed and the position of the cell, so
+// every process can set up its own region and get the same board for any process count
+void seedRegion(const Region *region, int width, unsigned seed) {
+    for (int i = 0; i < region->rows; i++) {
+        for (int j = 0; j < region->cols; j++) {
+            uint64_t x = ((uint64_t)(region->row0 + i) * width + region->col0 + j) + ((uint64_t)seed << 40);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull; // splitmix64 finalizer
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            region->cells[(size_t)i * region->ld + j] = (int)((x ^ (x >> 31)) >> 63);
+        }
     }
+}
 
-    free(slice);
-    free(newSlice);
+static MPI_File openBoard(const char *path, int amode) {
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, amode, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return fh;
+}
 
-    MPI_Finalize();
-    return 0;
+// Every process reads the header of a board file and checks it
+void readBoardHeader(const char *path, BoardHeader *header) {
+    MPI_File fh = openBoard(path, MPI_MODE_RDONLY);
+    MPI_File_read_at_all(fh, 0, header, sizeof(*header), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    if (memcmp(header->magic, BOARD_MAGIC, 8) != 0 || header->width <= 0 || header->width > INT32_MAX ||
+        header->height <= 0 || header->height > INT32_MAX || header->generation < 0) {
+        fprintf(stderr, "%s is not a board file\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 }
 
-void initializeGrid(int *grid, int width, int height) {
-    srand(time(NULL));
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            grid[i * width + j] = rand() % 2;
+// Collective read or write of the region of every process, through a file view of its
+// rows and bytes of the board. A process may have an empty region; it still joins the
+// collective call.
+static void accessBoard(MPI_File fh, const Run *run, const Region *region, int write) {
+    int rowBytes = (run->width + 7) / 8, regionBytes = (region->cols + 7) / 8;
+    MPI_Datatype fileType = MPI_BYTE;
+    int count = 0;
+    uint8_t *bytes = NULL;
+    if (region->rows > 0 && region->cols > 0) {
+        int sizes[2] = {run->height, rowBytes}, subsizes[2] = {region->rows, regionBytes};
+        int starts[2] = {region->row0, region->col0 / 8};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_BYTE, &fileType);
+        MPI_Type_commit(&fileType);
+        count = region->rows * regionBytes;
+        bytes = (uint8_t *)calloc(count, 1);
+    }
+    MPI_File_set_view(fh, sizeof(BoardHeader), MPI_BYTE, fileType, "native", MPI_INFO_NULL);
+
+    if (write) {
+        for (int i = 0; i < region->rows; i++) {
+            for (int j = 0; j < region->cols; j++) {
+                bytes[(size_t)i * regionBytes + j / 8] |= (region->cells[(size_t)i * region->ld + j] != 0) << (j % 8);
+            }
+        }
+        MPI_File_write_at_all(fh, 0, bytes, count, MPI_BYTE, MPI_STATUS_IGNORE);
+    } else {
+        MPI_File_read_at_all(fh, 0, bytes, count, MPI_BYTE, MPI_STATUS_IGNORE);
+        for (int i = 0; i < region->rows; i++) {
+            for (int j = 0; j < region->cols; j++) {
+                region->cells[(size_t)i * region->ld + j] = bytes[(size_t)i * regionBytes + j / 8] >> (j % 8) & 1;
+            }
         }
     }
+
+    if (count > 0) {
+        MPI_Type_free(&fileType);
+        free(bytes);
+    }
+}
+
+// Fill the region of every process with the starting board: the restart file, or a
+// random board
+void startRegion(const Run *run, const Region *region) {
+    if (run->restart == NULL) {
+        seedRegion(region, run->width, run->seed);
+        return;
+    }
+    MPI_File fh = openBoard(run->restart, MPI_MODE_RDONLY);
+    accessBoard(fh, run, region, 0);
+    MPI_File_close(&fh);
+}
+
+// Whether the board of this generation is to be written to the checkpoint file: every
+// checkpointEvery generations, and at the end of the run
+int checkpointDue(const Run *run, long long generation) {
+    if (run->checkpoint == NULL || generation == run->generation) return 0;
+    return generation == run->iterations || (run->checkpointEvery > 0 && generation % run->checkpointEvery == 0);
+}
+
+// Write the board of a generation to the checkpoint file, each process its own region.
+// The file is written under a temporary name and renamed once complete, so a crash
+// while writing leaves the last checkpoint intact.
+void writeCheckpoint(const Run *run, const Region *region, long long generation) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.tmp", run->checkpoint);
+
+    MPI_File fh = openBoard(path, MPI_MODE_CREATE | MPI_MODE_WRONLY);
+    MPI_File_set_size(fh, sizeof(BoardHeader) + (MPI_Offset)run->height * ((run->width + 7) / 8));
+    if (rank == 0) {
+        BoardHeader header = {BOARD_MAGIC, run->width, run->height, generation};
+        MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    accessBoard(fh, run, region, 1);
+    MPI_File_close(&fh);
+
+    if (rank == 0 && rename(path, run->checkpoint) != 0) {
+        fprintf(stderr, "Cannot rename %s to %s\n", path, run->checkpoint);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+// Report the end of a run: the board (with -print, collected on rank 0), its live
+// cells, and the time taken by rank 0
+void finishRun(const Run *run, const Region *region, double elapsed) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    long long live = 0;
+    for (int i = 0; i < region->rows; i++) {
+        for (int j = 0; j < region->cols; j++) live += region->cells[(size_t)i * region->ld + j];
+    }
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &live, &live, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (run->print) {
+        int place[4] = {region->row0, region->rows, region->col0, region->cols};
+        int *places = rank == 0 ? (int *)malloc(4 * size * sizeof(int)) : NULL;
+        MPI_Gather(place, 4, MPI_INT, places, 4, MPI_INT, 0, MPI_COMM_WORLD);
+
+        MPI_Datatype shape;
+        MPI_Request send = MPI_REQUEST_NULL;
+        if (region->rows > 0 && region->cols > 0) {
+            MPI_Type_vector(region->rows, region->cols, region->ld, MPI_INT, &shape);
+            MPI_Type_commit(&shape);
+            MPI_Isend(region->cells, 1, shape, 0, 0, MPI_COMM_WORLD, &send);
+        }
+        if (rank == 0) {
+            int *grid = (int *)malloc((size_t)run->width * run->height * sizeof(int));
+            for (int r = 0; r < size; r++) {
+                const int *at = places + 4 * r;
+                if (at[1] == 0 || at[3] == 0) continue;
+                MPI_Datatype onBoard;
+                MPI_Type_vector(at[1], at[3], run->width, MPI_INT, &onBoard);
+                MPI_Type_commit(&onBoard);
+                MPI_Recv(grid + (size_t)at[0] * run->width + at[2], 1, onBoard, r, 0, MPI_COMM_WORLD,
+                         MPI_STATUS_IGNORE);
+                MPI_Type_free(&onBoard);
+            }
+            printGrid(grid, run->width, run->height);
+            free(grid);
+            free(places);
+        }
+        MPI_Wait(&send, MPI_STATUS_IGNORE);
+        if (region->rows > 0 && region->cols > 0) MPI_Type_free(&shape);
+    }
+
+    if (rank == 0) {
+        printf("Generation: %lld\n", run->iterations);
+        printf("Live cells: %lld\n", live);
+        printf("Number of processes: %d\n", size);
+        printf("Execution time: %f seconds\n", elapsed);
+    }
 }
 
 void printGrid(int *grid, int width, int height) {
@@ -76,53 +497,850 @@ void printGrid(int *grid, int width, int height) {
     }
 }
 
-void updateGrid(int *grid, int *newGrid, int width, int height, int rank, int size) {
-    int above = rank - 1;
-    int below = rank + 1;
-    MPI_Status status;
+// Set up the block of this process on a dims[0] x dims[1] periodic process grid, with
+// a halo frame deep enough for halo generations of the rule of the run. The blocks
+// differ by at most a row and a byte of columns; the edges of neighbouring blocks
+// still match.
+void blockCreate(Block *block, const int dims[2], const Run *run, int halo) {
+    int width = run->width, height = run->height;
+    int periods[2] = {1, 1}, coords[2], rank;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, (int *)dims, periods, 0, &block->cart);
+    MPI_Comm_rank(block->cart, &rank);
+    MPI_Cart_coords(block->cart, rank, 2, coords);
+
+    // Columns are split in bytes of a board file, the last of which may be partial
+    int rowBytes = (width + 7) / 8;
+    block->row0 = blockStart(height, dims[0], coords[0]);
+    block->rows = blockStart(height, dims[0], coords[0] + 1) - block->row0;
+    block->col0 = 8 * blockStart(rowBytes, dims[1], coords[1]);
+    block->cols = MIN(8 * blockStart(rowBytes, dims[1], coords[1] + 1), width) - block->col0;
+    halo *= run->rule.radius; // A generation uses up radius cells of the frame
+    block->rule = &run->rule;
+    block->halo = halo;
+    block->stride = block->cols + 2 * halo;
+    block->tile = 0;
+
+    for (int d = 0; d < 8; d++) {
+        int dy = blockDirections[d][0], dx = blockDirections[d][1];
+        int at[2] = {coords[0] + dy, coords[1] + dx}; // Wrapped by MPI_Cart_rank, as both dimensions are periodic
+        MPI_Cart_rank(block->cart, at, &block->neighbors[d]);
+
+        // Rows are contiguous, columns and corners are strided
+        int shapeRows = dy == 0 ? block->rows : halo;
+        int shapeCols = dx == 0 ? block->cols : halo;
+        MPI_Type_vector(shapeRows, shapeCols, block->stride, MPI_INT, &block->shapes[d]);
+        MPI_Type_commit(&block->shapes[d]);
+
+        // The block occupies rows and columns halo..halo + rows - 1 (or cols - 1) of the frame
+        int sendRow = dy <= 0 ? halo : block->rows;
+        int sendCol = dx <= 0 ? halo : block->cols;
+        int recvRow = dy < 0 ? 0 : dy == 0 ? halo : block->rows + halo;
+        int recvCol = dx < 0 ? 0 : dx == 0 ? halo : block->cols + halo;
+        block->sendOffset[d] = sendRow * block->stride + sendCol;
+        block->recvOffset[d] = recvRow * block->stride + recvCol;
+    }
+
+    // A message carries the direction it travels in as its tag, so the edges stay apart
+    // even when several directions lead to the same process
+    size_t cellCount = (size_t)(block->rows + 2 * halo) * block->stride;
+    for (int b = 0; b < 2; b++) {
+        block->cells[b] = (int *)calloc(cellCount, sizeof(int));
+        for (int d = 0; d < 8; d++) {
+            MPI_Recv_init(block->cells[b] + block->recvOffset[d], 1, block->shapes[d], block->neighbors[d], d ^ 1,
+                          block->cart, &block->exchange[b][d]);
+            MPI_Send_init(block->cells[b] + block->sendOffset[d], 1, block->shapes[d], block->neighbors[d], d,
+                          block->cart, &block->exchange[b][8 + d]);
+        }
+    }
+    block->sums = (int *)malloc(block->stride * sizeof(int));
+}
+
+void blockFree(Block *block) {
+    for (int b = 0; b < 2; b++) {
+        for (int r = 0; r < 16; r++) MPI_Request_free(&block->exchange[b][r]);
+        free(block->cells[b]);
+    }
+    free(block->sums);
+    if (block->tile > 0) {
+        for (int d = 0; d < 8; d++) MPI_Request_free(&block->skipSends[d]);
+        free(block->changed);
+        free(block->changedBefore);
+    }
+    for (int d = 0; d < 8; d++) MPI_Type_free(&block->shapes[d]);
+    MPI_Comm_free(&block->cart);
+}
 
-    // Temporary arrays to store received rows from neighbors
-    int *topRow = (int *)malloc(width * sizeof(int));
-    int *bottomRow = (int *)malloc(width * sizeof(int));
+// Fill the halo frame of the current generation from the eight neighbours
+void blockExchange(Block *block, int current) {
+    MPI_Startall(16, block->exchange[current]);
+    MPI_Waitall(16, block->exchange[current], MPI_STATUSES_IGNORE);
+}
 
-    // Send and receive the top row
-    if (rank > 0) {
-        MPI_Sendrecv(grid, width, MPI_INT, above, 0, topRow, width, MPI_INT, above, 0, MPI_COMM_WORLD, &status);
+// Kernel of radius 1: the 3 x 3 square of each cell is added up directly
+static int updateMoore(const Block *block, int current, int row0, int row1, int col0, int col1) {
+    const int *cells = block->cells[current];
+    int *newCells = block->cells[!current];
+    const uint8_t *next = block->rule->next;
+    int stride = block->stride, changed = 0;
+    for (int i = row0; i <= row1; i++) {
+        const int *up = cells + (i - 1) * stride, *mid = cells + i * stride, *down = cells + (i + 1) * stride;
+        int *out = newCells + i * stride;
+        for (int j = col0; j <= col1; j++) {
+            int count = up[j - 1] + up[j] + up[j + 1] + mid[j - 1] + mid[j] + mid[j + 1] + down[j - 1] + down[j] +
+                        down[j + 1];
+            out[j] = next[2 * count + mid[j]];
+            changed |= out[j] != mid[j];
+        }
     }
+    return changed;
+}
+
+// Kernel of larger radii r: the sums of the 2r + 1 rows around a row are kept for each
+// column and moved down a row at a time, and the square of each cell is a running sum
+// of 2r + 1 of them moved along the row, so a cell costs the same at any radius
+static int updateWindow(const Block *block, int current, int row0, int row1, int col0, int col1) {
+    const int *cells = block->cells[current];
+    int *newCells = block->cells[!current];
+    const uint8_t *next = block->rule->next;
+    int stride = block->stride, r = block->rule->radius, changed = 0;
+    int *sums = block->sums; // Sums of columns col0 - r..col1 + r, indexed by column
+    if (row0 > row1 || col0 > col1) return 0;
 
-    // Send and receive the bottom row
-    if (rank < size - 1) {
-        MPI_Sendrecv(&grid[width * (height - 1)], width, MPI_INT, below, 0, bottomRow, width, MPI_INT, below, 0, MPI_COMM_WORLD, &status);
+    for (int j = col0 - r; j <= col1 + r; j++) {
+        sums[j] = 0;
+        for (int i = row0 - r; i <= row0 + r; i++) sums[j] += cells[i * stride + j];
     }
+    for (int i = row0; i <= row1; i++) {
+        if (i > row0) {
+            const int *enter = cells + (i + r) * stride, *leave = cells + (i - r - 1) * stride;
+            for (int j = col0 - r; j <= col1 + r; j++) sums[j] += enter[j] - leave[j];
+        }
+        const int *mid = cells + i * stride;
+        int *out = newCells + i * stride;
+        int count = 0;
+        for (int j = col0 - r; j < col0 + r; j++) count += sums[j];
+        for (int j = col0; j <= col1; j++) {
+            count += sums[j + r];
+            out[j] = next[2 * count + mid[j]];
+            changed |= out[j] != mid[j];
+            count -= sums[j - r];
+        }
+    }
+    return changed;
+}
+
+// Update the cells in rows row0..row1 and columns col0..col1 of the frame (inclusive)
+// of the current generation into the next one, with the kernel for the radius of the
+// rule. Returns whether any of them changed.
+int updateRegion(const Block *block, int current, int row0, int row1, int col0, int col1) {
+    if (block->rule->radius == 1) return updateMoore(block, current, row0, row1, col0, col1);
+    return updateWindow(block, current, row0, row1, col0, col1);
+}
 
-    // Compute new states for each cell
+// Generation step of the block after a halo exchange, for step = 0..k - 1 with a halo
+// of k generations. A fresh halo holds the cells the next k generations of the block
+// depend on, so each step updates the frame less radius more cells on each side than
+// the last, down to just the block at step k - 1. With overlap the exchange is started
+// by step 0, which updates the cells away from the halo while it is in flight and the
+// ring around them once it has arrived.
+void updateBlock(Block *block, int current, int step, int overlap) {
+    int h = block->halo, r = block->rule->radius;
+    int first = r * (step + 1);
+    int lastRow = block->rows + 2 * h - 1 - first, lastCol = block->cols + 2 * h - 1 - first;
+    if (step > 0 || !overlap) {
+        if (step == 0) blockExchange(block, current);
+        updateRegion(block, current, first, lastRow, first, lastCol);
+        return;
+    }
+
+    // The inner cells are those at least r cells away from the halo
+    int innerRow = block->rows + h - 1 - r, innerCol = block->cols + h - 1 - r;
+    MPI_Startall(16, block->exchange[current]);
+    updateRegion(block, current, h + r, innerRow, h + r, innerCol);
+    MPI_Waitall(16, block->exchange[current], MPI_STATUSES_IGNORE);
+
+    // Bands of h rows above and below the inner cells, and of h columns beside them
+    updateRegion(block, current, r, h + r - 1, r, lastCol);
+    updateRegion(block, current, MAX(h + r, innerRow + 1), lastRow, r, lastCol);
+    updateRegion(block, current, h + r, innerRow, r, h + r - 1);
+    updateRegion(block, current, h + r, innerRow, MAX(h + r, innerCol + 1), lastCol);
+}
+
+// Track the changes of the block in tiles of tile x tile cells (the last row and
+// column of tiles may be smaller). Every tile counts as changed to begin with.
+void blockTiles(Block *block, int tile) {
+    block->tile = tile;
+    block->tilesY = (block->rows + tile - 1) / tile;
+    block->tilesX = (block->cols + tile - 1) / tile;
+    size_t tileCount = (size_t)block->tilesY * block->tilesX;
+    block->changed = (uint8_t *)malloc(tileCount);
+    block->changedBefore = (uint8_t *)malloc(tileCount);
+    memset(block->changed, 1, tileCount);
+    memset(block->changedBefore, 1, tileCount);
+
+    // With the tag of the side itself, so the neighbour's receive matches either
+    for (int d = 0; d < 8; d++) {
+        MPI_Send_init(NULL, 0, MPI_BYTE, block->neighbors[d], d, block->cart, &block->skipSends[d]);
+    }
+}
+
+// Whether tile (a, b) holds cells of the side of the block in direction d, which is as
+// deep as the radius of the rule (the last row or column of tiles may be shallower)
+static int tileOnSide(const Block *block, int a, int b, int d) {
+    int dy = blockDirections[d][0], dx = blockDirections[d][1], r = block->rule->radius, t = block->tile;
+    int onRows = dy == 0 || (dy < 0 ? a * t < r : (a + 1) * t > block->rows - r);
+    int onCols = dx == 0 || (dx < 0 ? b * t < r : (b + 1) * t > block->cols - r);
+    return onRows && onCols;
+}
+
+// Whether tile (a, b) depends on the halo
+static int tileNearHalo(const Block *block, int a, int b) {
+    for (int d = 0; d < 4; d++) {
+        if (tileOnSide(block, a, b, d)) return 1;
+    }
+    return 0;
+}
+
+// Update tile (a, b) if it or a tile next to it changed in the last generation, or if
+// it borders a halo that was sent again
+static void updateTile(Block *block, int current, int a, int b) {
+    int active = 0;
+    for (int i = MAX(a - 1, 0); i <= MIN(a + 1, block->tilesY - 1); i++) {
+        for (int j = MAX(b - 1, 0); j <= MIN(b + 1, block->tilesX - 1); j++) {
+            active |= block->changed[i * block->tilesX + j];
+        }
+    }
+    for (int d = 0; d < 8 && !active; d++) active = block->recvFlags[d] && tileOnSide(block, a, b, d);
+
+    int changed = 0;
+    if (active) {
+        int row0 = block->halo + a * block->tile, col0 = block->halo + b * block->tile;
+        changed = updateRegion(block, current, row0, MIN(row0 + block->tile - 1, block->rows + block->halo - 1), col0,
+                               MIN(col0 + block->tile - 1, block->cols + block->halo - 1));
+    }
+    block->changedBefore[a * block->tilesX + b] = changed; // Becomes the new changed below
+}
+
+// One generation of the block, updating only the tiles near changes. Each side of the
+// halo is sent only if a tile on it changed in one of the last two generations (the
+// halo of this generation's buffer was last filled two generations ago), and as an
+// empty message otherwise, so a neighbour learns whether its side was filled from the
+// size of the one message it receives. The inner tiles are updated while the halo is
+// in flight.
+void updateTiles(Block *block, int current) {
+    int tilesY = block->tilesY, tilesX = block->tilesX;
+    for (int d = 0; d < 8; d++) {
+        block->sendFlags[d] = 0;
+        for (int a = 0; a < tilesY; a++) {
+            for (int b = 0; b < tilesX; b++) {
+                if (tileOnSide(block, a, b, d)) {
+                    block->sendFlags[d] |= block->changed[a * tilesX + b] | block->changedBefore[a * tilesX + b];
+                }
+            }
+        }
+    }
+
+    // Requests that are not started complete at once in MPI_Waitall
+    for (int d = 0; d < 8; d++) {
+        MPI_Start(&block->exchange[current][d]);
+        MPI_Start(block->sendFlags[d] ? &block->exchange[current][8 + d] : &block->skipSends[d]);
+    }
+    for (int a = 0; a < tilesY; a++) {
+        for (int b = 0; b < tilesX; b++) {
+            if (!tileNearHalo(block, a, b)) updateTile(block, current, a, b);
+        }
+    }
+    MPI_Status statuses[16];
+    MPI_Waitall(16, block->exchange[current], statuses);
+    MPI_Waitall(8, block->skipSends, MPI_STATUSES_IGNORE);
+    for (int d = 0; d < 8; d++) {
+        int count;
+        MPI_Get_count(&statuses[d], block->shapes[d], &count);
+        block->recvFlags[d] = count > 0;
+    }
+
+    for (int a = 0; a < tilesY; a++) {
+        for (int b = 0; b < tilesX; b++) {
+            if (tileNearHalo(block, a, b)) updateTile(block, current, a, b);
+        }
+    }
+
+    uint8_t *temp = block->changed;
+    block->changed = block->changedBefore;
+    block->changedBefore = temp;
+}
+
+// Time the exchange of a halo of one generation and the update of the block, and pick
+// the number of generations k of the halo with the smallest modelled time per
+// generation. A halo of k generations replaces k - 1 exchanges out of every k by
+// updates of the frame, which grows with k; the messages are short enough for their
+// latency to dominate, so an exchange costs the same at any depth.
+int chooseHalo(const Run *run, const int dims[2], int rank) {
+    enum { REPEATS = 20 };
+    Block block;
+    blockCreate(&block, dims, run, 1);
+    int r = run->rule.radius;
+
+    double times[2];
+    MPI_Barrier(MPI_COMM_WORLD);
+    double startTime = MPI_Wtime();
+    for (int repeat = 0; repeat < REPEATS; repeat++) blockExchange(&block, 0);
+    times[0] = (MPI_Wtime() - startTime) / REPEATS;
+
+    startTime = MPI_Wtime();
+    for (int repeat = 0; repeat < REPEATS; repeat++) {
+        updateRegion(&block, 0, r, block.rows + r - 1, r, block.cols + r - 1);
+    }
+    times[1] = (MPI_Wtime() - startTime) / REPEATS / ((double)block.rows * block.cols);
+    MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    int smallest[2] = {block.rows, block.cols};
+    MPI_Allreduce(MPI_IN_PLACE, smallest, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    int best = 1, maxHalo = MAX(MIN(MIN(smallest[0], smallest[1]) / r, MAX_HALO), 1);
+    double bestTime = 0.0;
+    for (int k = 1; k <= maxHalo; k++) {
+        double cells = 0.0;
+        for (int step = 0; step < k; step++) {
+            cells += (double)(block.rows + 2 * r * (k - 1 - step)) * (block.cols + 2 * r * (k - 1 - step));
+        }
+        double generationTime = (times[0] + times[1] * cells) / k;
+        if (k == 1 || generationTime < bestTime) {
+            best = k;
+            bestTime = generationTime;
+        }
+    }
+    if (rank == 0) {
+        printf("Exchange %.2f us, update %.2f ns per cell: halo of %d generations\n", times[0] * 1e6, times[1] * 1e9,
+               best);
+    }
+
+    blockFree(&block);
+    return best;
+}
+
+// Run the cells engine: every process sets up, updates and writes out its own block.
+// A halo of 0 generations is picked by chooseHalo.
+void runCells(const Run *run, int dims[2], int halo, int overlap, int tile, int rank) {
+    Block block;
+    if (dims[0] > run->height || dims[1] > (run->width + 7) / 8) {
+        if (rank == 0) printf("The %d x %d process grid is too large for the board.\n", dims[0], dims[1]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (halo == 0) halo = chooseHalo(run, dims, rank);
+    blockCreate(&block, dims, run, halo);
+
+    // The smallest blocks decide how deep the halo can be
+    int smallest[2] = {block.rows, block.cols};
+    MPI_Allreduce(MPI_IN_PLACE, smallest, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (block.halo > smallest[0] || block.halo > smallest[1]) {
+        if (rank == 0) printf("A halo %d deep is deeper than the smallest blocks.\n", block.halo);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (tile > 0 && (halo != 1 || tile < run->rule.radius)) {
+        if (rank == 0) printf("Tiles need a halo of one generation, and a side of at least the radius of the rule.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (tile > 0) blockTiles(&block, tile);
+    int current = 0;
+    int origin = block.halo * block.stride + block.halo; // First cell of the block in the frame
+
+    Region region = {block.row0, block.rows, block.col0, block.cols, block.cells[0] + origin, block.stride};
+    startRegion(run, &region);
+
+    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before starting the timer
+    double startTime = MPI_Wtime();
+
+    for (long long generation = run->generation; generation < run->iterations; generation++) {
+        if (tile > 0) updateTiles(&block, current);
+        else updateBlock(&block, current, (generation - run->generation) % halo, overlap);
+        current = !current;
+
+        region.cells = block.cells[current] + origin;
+        if (checkpointDue(run, generation + 1)) writeCheckpoint(run, &region, generation + 1);
+    }
+
+    double endTime = MPI_Wtime();
+
+    finishRun(run, &region, endTime - startTime);
+    blockFree(&block);
+}
+
+// Pack height rows of int cells into rows 1..height of a packed slice. Cell j of a row
+// is bit j % 64 of cell word j / 64, and cell word 0 is word 1 of the row.
+void packGrid(const int *grid, uint64_t *packed, int width, int height) {
+    int stride = (width + 63) / 64 + 2;
+    for (int i = 0; i < height; i++) {
+        uint64_t *row = packed + (size_t)(i + 1) * stride + 1;
+        memset(row, 0, (stride - 1) * sizeof(uint64_t));
+        for (int j = 0; j < width; j++) {
+            row[j / 64] |= (uint64_t)(grid[i * width + j] & 1) << (j % 64);
+        }
+    }
+}
+
+void unpackGrid(const uint64_t *packed, int *grid, int width, int height) {
+    int stride = (width + 63) / 64 + 2;
     for (int i = 0; i < height; i++) {
+        const uint64_t *row = packed + (size_t)(i + 1) * stride + 1;
         for (int j = 0; j < width; j++) {
-            int liveNeighbors = 0;
-
-            // Determine the start and end indices for neighbors
-            int rowStart = i > 0 ? i - 1 : (rank == 0 ? -1 : height - 1);
-            int rowEnd = i < height - 1 ? i + 1 : (rank == size - 1 ? -1 : 0);
-            int colStart = j > 0 ? j - 1 : -1;
-            int colEnd = j < width - 1 ? j + 1 : -1;
-
-            // Count live neighbors
-            for (int x = rowStart; x <= rowEnd; x++) {
-                for (int y = colStart; y <= colEnd; y++) {
-                    if (x == i && y == j) continue; // Skip the cell itself
-                    if (x == -1 && topRow[y] == 1) liveNeighbors++; // Top neighbor
-                    else if (x == height && bottomRow[y] == 1) liveNeighbors++; // Bottom neighbor
-                    else if (x >= 0 && x < height && y >= 0 && grid[x * width + y] == 1) liveNeighbors++;
+            grid[i * width + j] = (int)(row[j / 64] >> (j % 64) & 1);
+        }
+    }
+}
+
+// Set up the horizontal wraparound of one packed row: bit 63 of the ghost word becomes
+// the last cell, and the bit just past the last cell becomes the first cell. The rest
+// of the words past the last cell is cleared.
+static void wrapRow(uint64_t *row, int width) {
+    uint64_t *cells = row + 1;
+    int last = width - 1;
+    uint64_t lastCell = cells[last / 64] >> (last % 64) & 1;
+    uint64_t firstCell = cells[0] & 1;
+    uint64_t *edge = &cells[width / 64];
+    row[0] = lastCell << 63;
+    *edge = (*edge & ((UINT64_C(1) << (width % 64)) - 1)) | firstCell << (width % 64);
+    if (width % 64 != 0) {
+        edge[1] = 0;
+    }
+}
+
+// Game of Life for 64 cells per word, bit-sliced: the neighbour counts of all the
+// cells in a word are added at once with full adders on whole words. The rows above
+// and below give 3-cell sums (ones s, twos c), the middle row a 2-cell sum. Adding the
+// three ones bits gives the ones bit of the count and a carry k; the count is 2 or 3
+// exactly when one of the four twos bits (the three c and k) is set.
+#define LIFE_WORDS(T, up, mid, down, upL, midL, downL, upR, midR, downR, next)                  \
+    do {                                                                                         \
+        T nw = (up) << 1 | (upL) >> 63, ne = (up) >> 1 | (upR) << 63;                            \
+        T w = (mid) << 1 | (midL) >> 63, e = (mid) >> 1 | (midR) << 63;                          \
+        T sw = (down) << 1 | (downL) >> 63, se = (down) >> 1 | (downR) << 63;                    \
+        T sUp = nw ^ (up) ^ ne, cUp = (nw & (up)) | (ne & (nw ^ (up)));                          \
+        T sMid = w ^ e, cMid = w & e;                                                            \
+        T sDown = sw ^ (down) ^ se, cDown = (sw & (down)) | (se & (sw ^ (down)));                \
+        T ones = sUp ^ sMid ^ sDown, k = (sUp & sMid) | (sDown & (sUp ^ sMid));                  \
+        T oneTwo = (cUp ^ cMid ^ cDown ^ k) & ~((cUp & cMid) | (cDown & k));                     \
+        next = oneTwo & (ones | (mid));                                                          \
+    } while (0)
+
+// Any other rule of radius 1, also bit-sliced: the four twos bits are added on to give
+// the twos, fours and eights bits of the count, and a cell lives if the mask of the
+// rule for its count and state is set. The masks are words (or lanes) of all ones or
+// all zeros, so there is no branch on the rule.
+#define RULE_WORDS(T, up, mid, down, upL, midL, downL, upR, midR, downR, masks, next)           \
+    do {                                                                                        \
+        T nw = (up) << 1 | (upL) >> 63, ne = (up) >> 1 | (upR) << 63;                           \
+        T w = (mid) << 1 | (midL) >> 63, e = (mid) >> 1 | (midR) << 63;                         \
+        T sw = (down) << 1 | (downL) >> 63, se = (down) >> 1 | (downR) << 63;                   \
+        T sUp = nw ^ (up) ^ ne, cUp = (nw & (up)) | (ne & (nw ^ (up)));                         \
+        T sMid = w ^ e, cMid = w & e;                                                           \
+        T sDown = sw ^ (down) ^ se, cDown = (sw & (down)) | (se & (sw ^ (down)));               \
+        T ones = sUp ^ sMid ^ sDown, k = (sUp & sMid) | (sDown & (sUp ^ sMid));                 \
+        T x = cUp ^ cMid ^ cDown, y = (cUp & cMid) | (cDown & (cUp ^ cMid));                    \
+        T twos = x ^ k, fours = y ^ (x & k), eights = y & x & k;                                \
+        next = (T){0};                                                                          \
+        for (int n = 0; n <= 8; n++) {                                                          \
+            T count = (n & 1 ? ones : ~ones) & (n & 2 ? twos : ~twos) &                         \
+                      (n & 4 ? fours : ~fours) & (n & 8 ? eights : ~eights);                    \
+            next |= count & ((~(mid) & (masks)[0][n]) | ((mid) & (masks)[1][n]));               \
+        }                                                                                       \
+    } while (0)
+
+// One row of the packed slice, LANES words at a time with a word-at-a-time loop for the
+// rest. Inlined with a constant life, so the rule's kernel is picked once per row.
+#if defined(__GNUC__)
+__attribute__((always_inline))
+#endif
+static inline void updatePackedRow(const uint64_t *up, const uint64_t *mid, const uint64_t *down, uint64_t *out,
+                                   int words, const Rule *rule, int life) {
+    int j = 0;
+#if defined(__GNUC__)
+    for (; j + LANES <= words; j += LANES) {
+        Lanes u, m, d, uL, mL, dL, uR, mR, dR, next;
+        memcpy(&u, up + j, sizeof(Lanes));
+        memcpy(&m, mid + j, sizeof(Lanes));
+        memcpy(&d, down + j, sizeof(Lanes));
+        memcpy(&uL, up + j - 1, sizeof(Lanes));
+        memcpy(&mL, mid + j - 1, sizeof(Lanes));
+        memcpy(&dL, down + j - 1, sizeof(Lanes));
+        memcpy(&uR, up + j + 1, sizeof(Lanes));
+        memcpy(&mR, mid + j + 1, sizeof(Lanes));
+        memcpy(&dR, down + j + 1, sizeof(Lanes));
+        if (life) LIFE_WORDS(Lanes, u, m, d, uL, mL, dL, uR, mR, dR, next);
+        else RULE_WORDS(Lanes, u, m, d, uL, mL, dL, uR, mR, dR, rule->masks, next);
+        memcpy(out + j, &next, sizeof(Lanes));
+    }
+#endif
+    for (; j < words; j++) {
+        uint64_t next;
+        if (life) {
+            LIFE_WORDS(uint64_t, up[j], mid[j], down[j], up[j - 1], mid[j - 1], down[j - 1], up[j + 1], mid[j + 1],
+                       down[j + 1], next);
+        } else {
+            RULE_WORDS(uint64_t, up[j], mid[j], down[j], up[j - 1], mid[j - 1], down[j - 1], up[j + 1], mid[j + 1],
+                       down[j + 1], rule->masks, next);
+        }
+        out[j] = next;
+    }
+}
+
+// One generation of the packed slice: exchange the packed edge rows with the
+// neighbouring slices, set up the wraparound of every row, and update the rows
+void updatePacked(uint64_t *packed, uint64_t *newPacked, int width, int height, const Rule *rule, int rank, int size) {
+    int above = (rank - 1 + size) % size;
+    int below = (rank + 1) % size;
+    int stride = (width + 63) / 64 + 2;
+    int words = (width + 63) / 64;
+
+    MPI_Sendrecv(packed + stride, stride, MPI_UINT64_T, above, 0, packed + (size_t)(height + 1) * stride, stride,
+                 MPI_UINT64_T, below, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(packed + (size_t)height * stride, stride, MPI_UINT64_T, below, 1, packed, stride, MPI_UINT64_T,
+                 above, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    for (int i = 0; i < height + 2; i++) {
+        wrapRow(packed + (size_t)i * stride, width);
+    }
+
+    for (int i = 1; i <= height; i++) {
+        const uint64_t *up = packed + (size_t)(i - 1) * stride + 1;
+        const uint64_t *mid = packed + (size_t)i * stride + 1;
+        const uint64_t *down = packed + (size_t)(i + 1) * stride + 1;
+        uint64_t *out = newPacked + (size_t)i * stride + 1;
+        if (rule->life) updatePackedRow(up, mid, down, out, words, rule, 1);
+        else updatePackedRow(up, mid, down, out, words, rule, 0);
+    }
+}
+
+// Run the packed engine: every process sets up a slab of rows, packs it, and unpacks
+// it again for checkpoints and at the end
+void runPacked(const Run *run, int rank, int size) {
+    int width = run->width;
+    if (size > run->height) {
+        if (rank == 0) printf("There are more processes than rows on the board.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int row0 = blockStart(run->height, size, rank);
+    int sliceHeight = blockStart(run->height, size, rank + 1) - row0;
+    int *slice = (int *)malloc((size_t)width * sliceHeight * sizeof(int));
+
+    Region region = {row0, sliceHeight, 0, width, slice, width};
+    startRegion(run, &region);
+
+    // The packed slice has a halo row above and below, and (width + 63) / 64 + 2 words per row
+    size_t packedSize = (size_t)(sliceHeight + 2) * ((width + 63) / 64 + 2) * sizeof(uint64_t);
+    uint64_t *packedSlice = (uint64_t *)calloc(1, packedSize);
+    uint64_t *newPackedSlice = (uint64_t *)calloc(1, packedSize);
+    packGrid(slice, packedSlice, width, sliceHeight);
+
+    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before starting the timer
+    double startTime = MPI_Wtime();
+
+    for (long long generation = run->generation; generation < run->iterations; generation++) {
+        updatePacked(packedSlice, newPackedSlice, width, sliceHeight, &run->rule, rank, size);
+
+        uint64_t *temp = packedSlice;
+        packedSlice = newPackedSlice;
+        newPackedSlice = temp;
+
+        if (checkpointDue(run, generation + 1)) {
+            unpackGrid(packedSlice, slice, width, sliceHeight);
+            writeCheckpoint(run, &region, generation + 1);
+        }
+    }
+
+    double endTime = MPI_Wtime();
+
+    unpackGrid(packedSlice, slice, width, sliceHeight);
+    finishRun(run, &region, endTime - startTime);
+
+    free(slice);
+    free(packedSlice);
+    free(newPackedSlice);
+}
+
+// Hash a quadruple of child nodes
+static uint64_t hashChildren(const Node *nw, const Node *ne, const Node *sw, const Node *se) {
+    uint64_t h = (uintptr_t)nw;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)ne;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)sw;
+    h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)se;
+    return h ^ (h >> 29);
+}
+
+// The node with the given quadrants, which all have the same level. Equal quadrants
+// always give the same node, so a node is created only the first time.
+Node *hashNode(HashLife *life, Node *nw, Node *ne, Node *sw, Node *se) {
+    size_t bucket = hashChildren(nw, ne, sw, se) & (life->bucketCount - 1);
+    for (Node *node = life->buckets[bucket]; node != NULL; node = node->next) {
+        if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se) return node;
+    }
+
+    Node *node = (Node *)malloc(sizeof(Node));
+    node->nw = nw;
+    node->ne = ne;
+    node->sw = sw;
+    node->se = se;
+    node->result = NULL;
+    node->level = nw->level + 1;
+    node->resultStep = -1;
+    node->alive = 0;
+    node->marked = 0;
+    node->next = life->buckets[bucket];
+    life->buckets[bucket] = node;
+
+    // Keep the chains short by doubling the table when it is full
+    if (++life->nodeCount > life->bucketCount) {
+        size_t bucketCount = 2 * life->bucketCount;
+        Node **buckets = (Node **)calloc(bucketCount, sizeof(Node *));
+        for (size_t b = 0; b < life->bucketCount; b++) {
+            for (Node *n = life->buckets[b], *next; n != NULL; n = next) {
+                next = n->next;
+                size_t to = hashChildren(n->nw, n->ne, n->sw, n->se) & (bucketCount - 1);
+                n->next = buckets[to];
+                buckets[to] = n;
+            }
+        }
+        free(life->buckets);
+        life->buckets = buckets;
+        life->bucketCount = bucketCount;
+    }
+    return node;
+}
+
+// The node of level level whose top left cell is (x, y) on the board repeated in both
+// directions
+Node *buildNode(HashLife *life, const int *grid, int width, int height, int x, int y, int level) {
+    if (level == 0) return &life->cells[grid[(size_t)(y % height) * width + x % width] != 0];
+    int half = 1 << (level - 1);
+    Node *nw = buildNode(life, grid, width, height, x, y, level - 1);
+    Node *ne = buildNode(life, grid, width, height, x + half, y, level - 1);
+    Node *sw = buildNode(life, grid, width, height, x, y + half, level - 1);
+    Node *se = buildNode(life, grid, width, height, x + half, y + half, level - 1);
+    return hashNode(life, nw, ne, sw, se);
+}
+
+// Write the cells of a node whose top left cell is (x, y) that lie on the board
+void readNode(const Node *node, int *grid, int width, int height, int x, int y) {
+    if (x >= width || y >= height) return;
+    if (node->level == 0) {
+        grid[(size_t)y * width + x] = node->alive;
+        return;
+    }
+    int half = 1 << (node->level - 1);
+    readNode(node->nw, grid, width, height, x, y);
+    readNode(node->ne, grid, width, height, x + half, y);
+    readNode(node->sw, grid, width, height, x, y + half);
+    readNode(node->se, grid, width, height, x + half, y + half);
+}
+
+// The centre 2 x 2 cells of a 4 x 4 node after one generation
+Node *successor4x4(HashLife *life, const Node *node) {
+    int cells[4][4];
+    const Node *quadrants[2][2] = {{node->nw, node->ne}, {node->sw, node->se}};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            const Node *quadrant = quadrants[i / 2][j / 2];
+            const Node *leaves[2][2] = {{quadrant->nw, quadrant->ne}, {quadrant->sw, quadrant->se}};
+            cells[i][j] = leaves[i % 2][j % 2]->alive;
+        }
+    }
+
+    Node *next[2][2];
+    for (int i = 1; i <= 2; i++) {
+        for (int j = 1; j <= 2; j++) {
+            int count = 0;
+            for (int di = -1; di <= 1; di++) {
+                for (int dj = -1; dj <= 1; dj++) count += cells[i + di][j + dj];
+            }
+            next[i - 1][j - 1] = &life->cells[life->rule->next[2 * count + cells[i][j]]];
+        }
+    }
+    return hashNode(life, next[0][0], next[0][1], next[1][0], next[1][1]);
+}
+
+// Keep node through the next collections, until the root stack is cut back below it
+static Node *pushRoot(HashLife *life, Node *node) {
+    if (life->rootCount == life->rootCapacity) {
+        life->rootCapacity = MAX(2 * life->rootCapacity, 64);
+        life->roots = (Node **)realloc(life->roots, life->rootCapacity * sizeof(Node *));
+    }
+    life->roots[life->rootCount++] = node;
+    return node;
+}
+
+// The centre half of a node of level k >= 2 after 2^step generations, where step is at
+// most k - 2 (larger steps are cut down to k - 2). The node is split into nine
+// overlapping quarters, each advanced by 2^step generations when step < k - 2 or by
+// half of that otherwise; the centre halves of the results are then put together, or
+// advanced by the other half of the generations. Garbage is collected on the way in
+// once the cache is full, so every node the steps in progress hold is on the root
+// stack by the time any successor is called.
+Node *successor(HashLife *life, Node *node, int step) {
+    step = MIN(step, node->level - 2);
+    if (node->resultStep == step) return node->result;
+
+    size_t base = life->rootCount;
+    pushRoot(life, node);
+    if (life->nodeCount > life->collectAbove) collectGarbage(life);
+
+    Node *result;
+    if (node->level == 2) {
+        result = successor4x4(life, node);
+    } else {
+        Node *nw = node->nw, *ne = node->ne, *sw = node->sw, *se = node->se;
+        Node *quarters[3][3] = {
+            {nw, hashNode(life, nw->ne, ne->nw, nw->se, ne->sw), ne},
+            {hashNode(life, nw->sw, nw->se, sw->nw, sw->ne), hashNode(life, nw->se, ne->sw, sw->ne, se->nw),
+             hashNode(life, ne->sw, ne->se, se->nw, se->ne)},
+            {sw, hashNode(life, sw->ne, se->nw, sw->se, se->sw), se},
+        };
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) pushRoot(life, quarters[i][j]);
+        }
+        Node *c[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) c[i][j] = pushRoot(life, successor(life, quarters[i][j], step));
+        }
+
+        Node *parts[2][2];
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                if (step < node->level - 2) {
+                    parts[i][j] = hashNode(life, c[i][j]->se, c[i][j + 1]->sw, c[i + 1][j]->ne, c[i + 1][j + 1]->nw);
+                } else {
+                    parts[i][j] = successor(
+                        life, hashNode(life, c[i][j], c[i][j + 1], c[i + 1][j], c[i + 1][j + 1]), step);
                 }
+                pushRoot(life, parts[i][j]);
             }
+        }
+        result = hashNode(life, parts[0][0], parts[0][1], parts[1][0], parts[1][1]);
+    }
+
+    life->rootCount = base;
+    node->result = result;
+    node->resultStep = step;
+    return result;
+}
+
+static void markNode(Node *node) {
+    if (node->level == 0 || node->marked) return;
+    node->marked = 1;
+    markNode(node->nw);
+    markNode(node->ne);
+    markNode(node->sw);
+    markNode(node->se);
+}
 
-            // Apply rules of the Game of Life
-            if (grid[i * width + j] == 1 && (liveNeighbors < 2 || liveNeighbors > 3)) newGrid[i * width + j] = 0; // Die
-            else if (grid[i * width + j] == 0 && liveNeighbors == 3) newGrid[i * width + j] = 1; // Live
-            else newGrid[i * width + j] = grid[i * width + j]; // Stay the same
+// Free every node that is not part of a node on the root stack. The memoized results
+// of the nodes that are kept are dropped unless they are kept as well. If the nodes in
+// use still fill more than half the cache, the next collection waits until there are
+// twice as many, rather than coming back after every few new nodes.
+void collectGarbage(HashLife *life) {
+    for (size_t r = 0; r < life->rootCount; r++) markNode(life->roots[r]);
+    for (size_t b = 0; b < life->bucketCount; b++) {
+        for (Node *node = life->buckets[b]; node != NULL; node = node->next) {
+            if (node->marked && node->result != NULL && !node->result->marked) {
+                node->result = NULL;
+                node->resultStep = -1;
+            }
+        }
+    }
+    for (size_t b = 0; b < life->bucketCount; b++) {
+        Node **link = &life->buckets[b];
+        while (*link != NULL) {
+            Node *node = *link;
+            if (node->marked) {
+                node->marked = 0;
+                link = &node->next;
+            } else {
+                *link = node->next;
+                free(node);
+                life->nodeCount--;
+            }
         }
     }
+    life->collections++;
+    life->collectAbove = MAX(life->maxNodes, 2 * life->nodeCount);
+}
+
+// Run the HashLife engine on rank 0; the other processes only join the collective
+// reads and writes of the board, with empty regions. The board sides must be powers
+// of two. The board repeats in both directions, so its wraparound is that of a square
+// of 2^m x 2^m cells, one node B. A square of 2^p x 2^p copies of B (p >= 2) advanced
+// by 2^step generations, step <= m + p - 2, has a centre that starts at a multiple of
+// 2^m, so its top left corner is the next board. The generations up to the next
+// checkpoint are taken as the sum of their binary digits. The node cache is collected
+// whenever it holds more than cacheBytes, within a step as well as between them; only
+// the nodes the step in progress needs can take it over that.
+void runHashLife(const Run *run, size_t cacheBytes, int rank) {
+    int width = run->width, height = run->height;
+    if ((width & (width - 1)) != 0 || (height & (height - 1)) != 0) {
+        if (rank == 0) printf("The HashLife engine needs board sides that are powers of two.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    Region region = {0, 0, 0, 0, NULL, width};
+    if (rank == 0) {
+        region.rows = height;
+        region.cols = width;
+        region.cells = (int *)malloc((size_t)width * height * sizeof(int));
+    }
+    startRegion(run, &region);
+
+    HashLife life = {0};
+    Node *board = NULL;
+    int m = 0;
+    while ((1 << m) < MAX(width, height)) m++;
+    if (rank == 0) {
+        life.bucketCount = 1024;
+        life.buckets = (Node **)calloc(life.bucketCount, sizeof(Node *));
+        life.maxNodes = MAX(cacheBytes / sizeof(Node), 1024);
+        life.collectAbove = life.maxNodes;
+        life.cells[1].alive = 1;
+        life.rule = &run->rule;
+        board = buildNode(&life, region.cells, width, height, 0, 0, m);
+    }
 
-    free(topRow);
-    free(bottomRow);
-}
\ No newline at end of file
+    MPI_Barrier(MPI_COMM_WORLD); // Synchronize before starting the timer
+    double startTime = MPI_Wtime();
+
+    for (long long generation = run->generation; generation < run->iterations;) {
+        long long generations = run->iterations - generation;
+        if (run->checkpoint != NULL && run->checkpointEvery > 0) {
+            generations = MIN(generations, run->checkpointEvery - generation % run->checkpointEvery);
+        }
+        for (int step = 62; step >= 0 && rank == 0; step--) {
+            if ((generations >> step & 1) == 0) continue;
+
+            int p = MAX(2, step - m + 2);
+            Node *root = board;
+            for (int i = 0; i < p; i++) root = hashNode(&life, root, root, root, root);
+            Node *next = successor(&life, root, step);
+            for (int i = 1; i < p; i++) next = next->nw;
+            board = next;
+        }
+        generation += generations;
+
+        if (checkpointDue(run, generation)) {
+            if (rank == 0) readNode(board, region.cells, width, height, 0, 0);
+            writeCheckpoint(run, &region, generation);
+        }
+    }
+
+    double endTime = MPI_Wtime();
+
+    if (rank == 0) {
+        readNode(board, region.cells, width, height, 0, 0);
+        printf("HashLife nodes: %zu, garbage collections: %d\n", life.nodeCount, life.collections);
+        for (size_t b = 0; b < life.bucketCount; b++) {
+            for (Node *node = life.buckets[b], *next; node != NULL; node = next) {
+                next = node->next;
+                free(node);
+            }
+        }
+        free(life.buckets);
+        free(life.roots);
+    }
+    finishRun(run, &region, endTime - startTime);
+    free(region.cells);
+}
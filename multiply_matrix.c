@@ -1,123 +1,2304 @@
+#define _GNU_SOURCE // For pthread_setaffinity_np and sched_getaffinity
+#include <errno.h>
 #include <mpi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
-// Function to multiply matrices, modified to take N as a parameter
-void multiplyMatrices(int *A, int *B, int *C, int rows, int N)
+
+// Register block of the micro-kernel: MR rows of A times NR columns of B (the
+// vector micro-kernel is written for MR = 4)
+#define MR 4
+#define NR 16
+
+// Cache blocks: an MC x KC block of A stays in L2, a KC x NC panel of B in L3,
+// and one KC x NR sliver of B in L1 while the micro-kernel sweeps over it
+#define MC 128
+#define KC 256
+#define NC 4096
+
+// Packing buffers of one thread, allocated once and shared by all element types: the
+// MC x KC block of A, then the KC x (NC + NR) panel of B, in elements of at most 8 bytes
+#define PACKED_A_BYTES ((size_t)MC * KC * 8)
+#define PACKED_BYTES (PACKED_A_BYTES + (size_t)KC * (NC + NR) * 8)
+
+// Element types. The kernels are generated for each pair of an input type T and the
+// type Acc that the products are summed in and C is stored in: the four plain types,
+// and int32 and float summed in the wider int64 and double (-wide).
+
+// Micro-kernel for one accumulator type: the MR x NR tile C (leading dimension ldc) is
+// overwritten with, or if accumulate is set incremented by, the product of a packed A
+// sliver and a packed B sliver of depth kc. With GCC and Clang each row of the tile is
+// one NR-wide vector, which the compiler maps onto the SIMD registers of the target
+// (two ZMM registers per row for 64-bit types with AVX-512, four YMM with AVX2).
+#if defined(__GNUC__)
+#define DEFINE_MICRO_KERNEL(Acc, name)                                                             \
+    typedef Acc name##Row __attribute__((vector_size(NR * sizeof(Acc))));                          \
+    static void microKernel_##name(int kc, const Acc *a, const Acc *b, Acc *C, int ldc,           \
+                                   int accumulate)                                                 \
+    {                                                                                              \
+        name##Row c0 = {0}, c1 = {0}, c2 = {0}, c3 = {0}, bv;                                      \
+        for (int p = 0; p < kc; p++, a += MR, b += NR)                                             \
+        {                                                                                          \
+            memcpy(&bv, b, sizeof(bv));                                                            \
+            c0 += a[0] * bv;                                                                       \
+            c1 += a[1] * bv;                                                                       \
+            c2 += a[2] * bv;                                                                       \
+            c3 += a[3] * bv;                                                                       \
+        }                                                                                          \
+        name##Row acc[MR] = {c0, c1, c2, c3};                                                      \
+        for (int r = 0; r < MR; r++)                                                               \
+        {                                                                                          \
+            if (accumulate)                                                                        \
+            {                                                                                      \
+                memcpy(&bv, C + (size_t)r * ldc, sizeof(bv));                                      \
+                acc[r] += bv;                                                                      \
+            }                                                                                      \
+            memcpy(C + (size_t)r * ldc, &acc[r], sizeof(bv));                                      \
+        }                                                                                          \
+    }
+#else
+#define DEFINE_MICRO_KERNEL(Acc, name)                                                             \
+    static void microKernel_##name(int kc, const Acc *a, const Acc *b, Acc *C, int ldc,           \
+                                   int accumulate)                                                 \
+    {                                                                                              \
+        Acc acc[MR][NR] = {{0}};                                                                   \
+        for (int p = 0; p < kc; p++, a += MR, b += NR)                                             \
+        {                                                                                          \
+            for (int r = 0; r < MR; r++)                                                           \
+            {                                                                                      \
+                for (int c = 0; c < NR; c++)                                                       \
+                {                                                                                  \
+                    acc[r][c] += a[r] * b[c];                                                      \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+        for (int r = 0; r < MR; r++)                                                               \
+        {                                                                                          \
+            for (int c = 0; c < NR; c++)                                                           \
+            {                                                                                      \
+                C[(size_t)r * ldc + c] = accumulate ? C[(size_t)r * ldc + c] + acc[r][c]           \
+                                                    : acc[r][c];                                   \
+            }                                                                                      \
+        }                                                                                          \
+    }
+#endif
+
+// Everything else for one pair of types:
+//  - multiplyNaive: the reference triple loop, C = A * B for a rows x N strip of A
+//  - packA: pack an mc x kc block of A into MR-row slivers, each stored column by
+//    column, padding the last sliver with zeros and widening to Acc
+//  - packB: pack a kc x nc panel of B into NR-column slivers, each stored row by row,
+//    likewise padded and widened
+//  - gemmBlocked: blocked GEMM in the GotoBLAS/BLIS style, C = A * B, or C += A * B
+//    if accumulate is set, where A is m x k, B is k x n and C is m x n, all row-major
+//    with the given leading dimensions, packing into the PACKED_BYTES buffer packed.
+//    Edge tiles go through a scratch tile so the micro-kernel always works on a full
+//    MR x NR block.
+//  - convert: widen count elements from T to Acc
+#define DEFINE_GEMM(T, Acc, name, accName)                                                         \
+    static void multiplyNaive_##name(const void *A_, const void *B_, void *C_, int rows, int N)   \
+    {                                                                                              \
+        const T *A = (const T *)A_, *B = (const T *)B_;                                            \
+        Acc *C = (Acc *)C_;                                                                        \
+        for (int i = 0; i < rows; i++)                                                             \
+        {                                                                                          \
+            for (int j = 0; j < N; j++)                                                            \
+            {                                                                                      \
+                C[(size_t)i * N + j] = 0;                                                          \
+                for (int k = 0; k < N; k++)                                                        \
+                {                                                                                  \
+                    C[(size_t)i * N + j] += (Acc)A[(size_t)i * N + k] * B[(size_t)k * N + j];      \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void packA_##name(int mc, int kc, const T *A, int lda, Acc *packed)                     \
+    {                                                                                              \
+        for (int i = 0; i < mc; i += MR)                                                           \
+        {                                                                                          \
+            int mr = mc - i < MR ? mc - i : MR;                                                    \
+            for (int p = 0; p < kc; p++)                                                           \
+            {                                                                                      \
+                for (int r = 0; r < MR; r++)                                                       \
+                {                                                                                  \
+                    *packed++ = r < mr ? (Acc)A[(size_t)(i + r) * lda + p] : 0;                    \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void packB_##name(int kc, int nc, const T *B, int ldb, Acc *packed)                     \
+    {                                                                                              \
+        for (int j = 0; j < nc; j += NR)                                                           \
+        {                                                                                          \
+            int nr = nc - j < NR ? nc - j : NR;                                                    \
+            for (int p = 0; p < kc; p++)                                                           \
+            {                                                                                      \
+                const T *row = B + (size_t)p * ldb + j;                                            \
+                for (int c = 0; c < NR; c++)                                                       \
+                {                                                                                  \
+                    *packed++ = c < nr ? (Acc)row[c] : 0;                                          \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void gemmBlocked_##name(int m, int n, int k, const void *A_, int lda, const void *B_,   \
+                                   int ldb, void *C_, int ldc, int accumulate, void *packed)       \
+    {                                                                                              \
+        const T *A = (const T *)A_, *B = (const T *)B_;                                            \
+        Acc *C = (Acc *)C_;                                                                        \
+        Acc *packedA = (Acc *)packed;                                                              \
+        Acc *packedB = (Acc *)((char *)packed + PACKED_A_BYTES);                                   \
+        Acc tile[MR * NR];                                                                         \
+                                                                                                   \
+        if (k == 0 && !accumulate)                                                                 \
+        {                                                                                          \
+            for (int i = 0; i < m; i++)                                                            \
+            {                                                                                      \
+                memset(C + (size_t)i * ldc, 0, n * sizeof(Acc));                                   \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        for (int jc = 0; jc < n; jc += NC)                                                         \
+        {                                                                                          \
+            int nc = n - jc < NC ? n - jc : NC;                                                    \
+            for (int pc = 0; pc < k; pc += KC)                                                     \
+            {                                                                                      \
+                int kc = k - pc < KC ? k - pc : KC;                                                \
+                int acc = accumulate || pc > 0;                                                    \
+                packB_##name(kc, nc, B + (size_t)pc * ldb + jc, ldb, packedB);                     \
+                                                                                                   \
+                for (int ic = 0; ic < m; ic += MC)                                                 \
+                {                                                                                  \
+                    int mc = m - ic < MC ? m - ic : MC;                                            \
+                    packA_##name(mc, kc, A + (size_t)ic * lda + pc, lda, packedA);                 \
+                                                                                                   \
+                    for (int jr = 0; jr < nc; jr += NR)                                            \
+                    {                                                                              \
+                        int nr = nc - jr < NR ? nc - jr : NR;                                      \
+                        for (int ir = 0; ir < mc; ir += MR)                                        \
+                        {                                                                          \
+                            int mr = mc - ir < MR ? mc - ir : MR;                                  \
+                            const Acc *a = packedA + ir * kc;                                      \
+                            const Acc *b = packedB + jr * kc;                                      \
+                            Acc *c = C + (size_t)(ic + ir) * ldc + jc + jr;                        \
+                                                                                                   \
+                            if (mr == MR && nr == NR)                                              \
+                            {                                                                      \
+                                microKernel_##accName(kc, a, b, c, ldc, acc);                      \
+                                continue;                                                          \
+                            }                                                                      \
+                                                                                                   \
+                            microKernel_##accName(kc, a, b, tile, NR, 0);                          \
+                            for (int r = 0; r < mr; r++)                                           \
+                            {                                                                      \
+                                for (int col = 0; col < nr; col++)                                 \
+                                {                                                                  \
+                                    c[(size_t)r * ldc + col] =                                     \
+                                        acc ? c[(size_t)r * ldc + col] + tile[r * NR + col]        \
+                                            : tile[r * NR + col];                                  \
+                                }                                                                  \
+                            }                                                                      \
+                        }                                                                          \
+                    }                                                                              \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void convert_##name(const void *in, void *out, size_t count)                            \
+    {                                                                                              \
+        for (size_t e = 0; e < count; e++)                                                         \
+        {                                                                                          \
+            ((Acc *)out)[e] = (Acc)((const T *)in)[e];                                             \
+        }                                                                                          \
+    }
+
+// Per element type: fill sets element index to value, add is Z = X + sign * Y for
+// h x h blocks (the Strassen sums), and print writes one element of C as text
+#define DEFINE_ELEMENT(T, name, format, Print)                                                     \
+    static void fill_##name(void *X, size_t index, long long value)                                \
+    {                                                                                              \
+        ((T *)X)[index] = (T)value;                                                                \
+    }                                                                                              \
+                                                                                                   \
+    static void add_##name(int h, const void *X_, int ldx, const void *Y_, int ldy, int sign,      \
+                           void *Z_, int ldz)                                                      \
+    {                                                                                              \
+        const T *X = (const T *)X_, *Y = (const T *)Y_;                                            \
+        T *Z = (T *)Z_;                                                                            \
+        for (int i = 0; i < h; i++)                                                                \
+        {                                                                                          \
+            for (int j = 0; j < h; j++)                                                            \
+            {                                                                                      \
+                Z[(size_t)i * ldz + j] = X[(size_t)i * ldx + j] + sign * Y[(size_t)i * ldy + j];   \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void print_##name(const void *X, size_t index)                                          \
+    {                                                                                              \
+        printf(format, (Print)((const T *)X)[index]);                                              \
+    }
+
+DEFINE_MICRO_KERNEL(int32_t, int32)
+DEFINE_MICRO_KERNEL(int64_t, int64)
+DEFINE_MICRO_KERNEL(float, float)
+DEFINE_MICRO_KERNEL(double, double)
+
+DEFINE_GEMM(int32_t, int32_t, int32, int32)
+DEFINE_GEMM(int64_t, int64_t, int64, int64)
+DEFINE_GEMM(float, float, float, float)
+DEFINE_GEMM(double, double, double, double)
+DEFINE_GEMM(int32_t, int64_t, int32_int64, int64)
+DEFINE_GEMM(float, double, float_double, double)
+
+DEFINE_ELEMENT(int32_t, int32, "%d ", int)
+DEFINE_ELEMENT(int64_t, int64, "%lld ", long long)
+DEFINE_ELEMENT(float, float, "%g ", double)
+DEFINE_ELEMENT(double, double, "%.17g ", double)
+
+typedef void (*GemmFunction)(int m, int n, int k, const void *A, int lda, const void *B, int ldb,
+                             void *C, int ldc, int accumulate, void *packed);
+
+// One entry per pair of types, selected at run time with -type and -wide. The type
+// codes are those of the matrix files: 0 int32, 1 int64, 2 float, 3 double, and the
+// entry with index c is the plain type with code c.
+typedef struct
+{
+    const char *name;
+    int code;             // Type of A and B
+    int accCode;          // Type of C, and of the products
+    size_t size, accSize; // Bytes per element
+    GemmFunction gemm;
+    void (*naive)(const void *A, const void *B, void *C, int rows, int N);
+    void (*convert)(const void *in, void *out, size_t count);
+    void (*fill)(void *X, size_t index, long long value); // A and B
+    void (*add)(int h, const void *X, int ldx, const void *Y, int ldy, int sign, void *Z,
+                int ldz);                                 // C
+    void (*print)(const void *X, size_t index);           // C
+} ElementType;
+
+static const ElementType elementTypes[] = {
+    {"int32", 0, 0, sizeof(int32_t), sizeof(int32_t), gemmBlocked_int32, multiplyNaive_int32,
+     convert_int32, fill_int32, add_int32, print_int32},
+    {"int64", 1, 1, sizeof(int64_t), sizeof(int64_t), gemmBlocked_int64, multiplyNaive_int64,
+     convert_int64, fill_int64, add_int64, print_int64},
+    {"float", 2, 2, sizeof(float), sizeof(float), gemmBlocked_float, multiplyNaive_float,
+     convert_float, fill_float, add_float, print_float},
+    {"double", 3, 3, sizeof(double), sizeof(double), gemmBlocked_double, multiplyNaive_double,
+     convert_double, fill_double, add_double, print_double},
+    {"int32 summed in int64", 0, 1, sizeof(int32_t), sizeof(int64_t), gemmBlocked_int32_int64,
+     multiplyNaive_int32_int64, convert_int32_int64, fill_int32, add_int64, print_int64},
+    {"float summed in double", 2, 3, sizeof(float), sizeof(double), gemmBlocked_float_double,
+     multiplyNaive_float_double, convert_float_double, fill_float, add_double, print_double},
+};
+
+// MPI datatype for a type code
+static MPI_Datatype mpiType(int code)
+{
+    switch (code)
+    {
+    case 1:
+        return MPI_INT64_T;
+    case 2:
+        return MPI_FLOAT;
+    case 3:
+        return MPI_DOUBLE;
+    default:
+        return MPI_INT32_T;
+    }
+}
+
+// Address of element index in a buffer of size-byte elements
+#define ELEMENT(X, index, size) ((char *)(X) + (size_t)(index) * (size))
+
+// Thread pool for the local multiply. The calling (MPI) thread works as thread 0,
+// and count - 1 workers wait at the start barrier for the next job. Each job is
+// one gemm call, which every thread runs on its own tile of C with its own packing
+// buffers.
+typedef struct
+{
+    int count;
+    pthread_t *threads;
+    void **packed; // PACKED_BYTES per thread
+    pthread_barrier_t start, done;
+    int quit;
+    // The current job
+    const ElementType *type;
+    int m, n, k, lda, ldb, ldc, accumulate;
+    const void *A, *B;
+    void *C;
+} ThreadPool;
+
+static ThreadPool pool = {.count = 1};
+
+#ifdef __linux__
+// The CPUs the process may run on (as set by the launcher, batch system or cgroup),
+// read before any thread is pinned
+static cpu_set_t poolCpus;
+#endif
+
+// Pin the calling thread to the k-th CPU (cyclically) of those the process may run
+// on, if the platform supports it
+static void pinThread(int k)
 {
-    for (int i = 0; i < rows; i++)
+#ifdef __linux__
+    int count = CPU_COUNT(&poolCpus);
+    if (count == 0)
+    {
+        return;
+    }
+    k %= count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
     {
-        for (int j = 0; j < N; j++)
+        if (CPU_ISSET(cpu, &poolCpus) && k-- == 0)
         {
-            C[i * N + j] = 0;
-            for (int k = 0; k < N; k++)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (error != 0)
             {
-                C[i * N + j] += A[i * N + k] * B[k * N + j];
+                fprintf(stderr, "Cannot pin a thread to CPU %d: %s\n", cpu, strerror(error));
             }
+            return;
         }
     }
+#else
+    (void)k;
+#endif
 }
 
-int main(int argc, char *argv[])
+// Run thread t's share of the current job. Wide tiles split the rows of C between
+// threads in multiples of MR; short ones split the columns in multiples of NR.
+static void poolTile(int t)
 {
-    int rank, size;
-    double startTime, endTime;
+    const ElementType *type = pool.type;
+    int T = pool.count;
+    if (pool.m >= T * MR || pool.n < T * NR)
+    {
+        int blocks = (pool.m + MR - 1) / MR;
+        int lo = blocks * t / T * MR, hi = blocks * (t + 1) / T * MR;
+        hi = hi < pool.m ? hi : pool.m;
+        if (lo < hi)
+        {
+            type->gemm(hi - lo, pool.n, pool.k, ELEMENT(pool.A, (size_t)lo * pool.lda, type->size),
+                       pool.lda, pool.B, pool.ldb,
+                       ELEMENT(pool.C, (size_t)lo * pool.ldc, type->accSize), pool.ldc,
+                       pool.accumulate, pool.packed[t]);
+        }
+    }
+    else
+    {
+        int blocks = (pool.n + NR - 1) / NR;
+        int lo = blocks * t / T * NR, hi = blocks * (t + 1) / T * NR;
+        hi = hi < pool.n ? hi : pool.n;
+        if (lo < hi)
+        {
+            type->gemm(pool.m, hi - lo, pool.k, pool.A, pool.lda, ELEMENT(pool.B, lo, type->size),
+                       pool.ldb, ELEMENT(pool.C, lo, type->accSize), pool.ldc, pool.accumulate,
+                       pool.packed[t]);
+        }
+    }
+}
 
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+typedef struct
+{
+    int index, cpu;
+} WorkerArgs;
 
-    // Print the number of processes
-    if (rank == 0)
+static void *poolWorker(void *arg)
+{
+    WorkerArgs *args = (WorkerArgs *)arg;
+    int t = args->index;
+    pinThread(args->cpu);
+    free(args);
+
+    for (;;)
     {
-        printf("Number of processes: %d\n", size);
+        pthread_barrier_wait(&pool.start);
+        if (pool.quit)
+        {
+            return NULL;
+        }
+        poolTile(t);
+        pthread_barrier_wait(&pool.done);
     }
+}
 
-    // Start timing
-    startTime = MPI_Wtime();
+// Start count threads per process. A single thread is left where the launcher put it;
+// more are pinned to consecutive CPUs of the process's affinity mask. When that mask
+// has room for every process on the node (the launcher did not bind them), the
+// process with node rank nodeRank takes the nodeRank-th group of count CPUs.
+static void poolStart(int count, int nodeRank, int nodeSize)
+{
+    pool.count = count > 1 ? count : 1;
+    pool.quit = 0;
+    pool.packed = (void **)malloc(pool.count * sizeof(void *));
+    for (int t = 0; t < pool.count; t++)
+    {
+        pool.packed[t] = malloc(PACKED_BYTES);
+    }
+    if (pool.count == 1)
+    {
+        return;
+    }
 
-    // Check for correct number of arguments and parse N
-    if (argc != 2)
+    int firstCpu = 0;
+#ifdef __linux__
+    if (sched_getaffinity(0, sizeof(poolCpus), &poolCpus) != 0)
     {
-        if (rank == 0)
+        fprintf(stderr, "Cannot read the CPU affinity, threads are not pinned: %s\n", strerror(errno));
+        CPU_ZERO(&poolCpus);
+    }
+    else if (CPU_COUNT(&poolCpus) >= nodeSize * pool.count)
+    {
+        firstCpu = nodeRank * pool.count;
+    }
+#else
+    (void)nodeRank;
+    (void)nodeSize;
+#endif
+    pinThread(firstCpu);
+
+    pthread_barrier_init(&pool.start, NULL, pool.count);
+    pthread_barrier_init(&pool.done, NULL, pool.count);
+    pool.threads = (pthread_t *)malloc(pool.count * sizeof(pthread_t));
+    for (int t = 1; t < pool.count; t++)
+    {
+        WorkerArgs *args = (WorkerArgs *)malloc(sizeof(WorkerArgs));
+        args->index = t;
+        args->cpu = firstCpu + t;
+        pthread_create(&pool.threads[t], NULL, poolWorker, args);
+    }
+}
+
+static void poolStop(void)
+{
+    if (pool.count > 1)
+    {
+        pool.quit = 1;
+        pthread_barrier_wait(&pool.start);
+        for (int t = 1; t < pool.count; t++)
         {
-            fprintf(stderr, "Usage: %s <N>\n", argv[0]);
+            pthread_join(pool.threads[t], NULL);
         }
+        pthread_barrier_destroy(&pool.start);
+        pthread_barrier_destroy(&pool.done);
+        free(pool.threads);
+    }
+    for (int t = 0; t < pool.count; t++)
+    {
+        free(pool.packed[t]);
+    }
+    free(pool.packed);
+    pool.count = 1;
+}
+
+// type->gemm split over the thread pool
+static void gemmParallel(const ElementType *type, int m, int n, int k, const void *A, int lda,
+                         const void *B, int ldb, void *C, int ldc, int accumulate)
+{
+    if (pool.count == 1)
+    {
+        type->gemm(m, n, k, A, lda, B, ldb, C, ldc, accumulate, pool.packed[0]);
+        return;
+    }
+    pool.type = type;
+    pool.m = m;
+    pool.n = n;
+    pool.k = k;
+    pool.A = A;
+    pool.lda = lda;
+    pool.B = B;
+    pool.ldb = ldb;
+    pool.C = C;
+    pool.ldc = ldc;
+    pool.accumulate = accumulate;
+    pthread_barrier_wait(&pool.start);
+    poolTile(0);
+    pthread_barrier_wait(&pool.done);
+}
+
+// Function to multiply matrices, modified to take N as a parameter
+static void multiplyMatrices(const ElementType *type, const void *A, const void *B, void *C,
+                             int rows, int N)
+{
+    gemmParallel(type, rows, N, N, A, N, B, N, C, N, 0);
+}
+
+// Rank 0 prints the run time, the split between communication and computation
+// (slowest process), and the rate of the local multiply, which is 2 N^3
+// operations in total, finished when the slowest process is done
+static void printTiming(int N, int size, double elapsed, double computeTime, double commTime)
+{
+    double times[2] = {computeTime, commTime}, timesMax[2];
+    MPI_Reduce(times, timesMax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0)
+    {
+        double gflops = 2.0 * N * N * (double)N / timesMax[0] * 1e-9;
+        printf("Execution time: %f seconds\n", elapsed);
+        printf("Communication: %f seconds, computation: %f seconds\n", timesMax[1], timesMax[0]);
+        printf("Local multiply: %f seconds, %.2f GFLOP/s total, %.2f GFLOP/s per process, "
+               "%d threads per process\n",
+               timesMax[0], gflops, gflops / size, pool.count);
+    }
+}
+
+// Balanced row split for any N: the first N % size processes get one extra row.
+// counts and displs are in elements of an N-column matrix.
+static void rowSplit(int N, int size, int *counts, int *displs)
+{
+    int offset = 0;
+    for (int r = 0; r < size; r++)
+    {
+        int rows = N / size + (r < N % size);
+        counts[r] = rows * N;
+        displs[r] = offset;
+        offset += rows * N;
+    }
+}
+
+// Binary matrix files: a fixed header followed by the N x N elements in row-major
+// order, native byte order. Written and read by every process at once through MPI-IO.
+#define MATRIX_MAGIC "MPIMATRX"
+
+typedef struct
+{
+    char magic[8];
+    int64_t rows;
+    int64_t cols;
+    int32_t type;     // Element type code, as in elementTypes
+    int32_t elemSize; // Bytes per element
+} MatrixHeader;
+
+// Where the matrices come from and go to
+typedef struct
+{
+    const char *pathA; // Input files, or NULL to generate A and B
+    const char *pathB;
+    const char *pathC; // Output file, or NULL
+    int print;         // Print C as text, for debugging with small N
+} MatrixIo;
+
+static MPI_File openMatrix(const char *path, int amode)
+{
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, amode, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    int N = atoi(argv[1]);
-    if (N % size != 0)
+    return fh;
+}
+
+// Every process reads the header; returns N after checking the file holds a square matrix,
+// and sets code to its element type
+static int readMatrixSize(const char *path, int *code)
+{
+    MatrixHeader header;
+    MPI_File fh = openMatrix(path, MPI_MODE_RDONLY);
+    MPI_File_read_at_all(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    // N * N must fit in an int, as in the rest of the program
+    if (memcmp(header.magic, MATRIX_MAGIC, 8) != 0 || header.rows != header.cols || header.rows <= 0 ||
+        header.rows > 46340 || header.type < 0 || header.type > 3 ||
+        header.elemSize != (int32_t)elementTypes[header.type].size)
     {
-        if (rank == 0)
+        fprintf(stderr, "%s is not a square matrix file\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    *code = header.type;
+    return (int)header.rows;
+}
+
+// Collective read or write of the rows x cols block at (row0, col0) of the N x N matrix
+// of type code in the file, to or from buf with leading dimension ld. A process may take
+// an empty block; it still joins the collective call.
+static void accessBlock(MPI_File fh, int N, int code, int row0, int rows, int col0, int cols,
+                        void *buf, int ld, int write)
+{
+    MPI_Datatype element = mpiType(code), fileType = element, memType = element;
+    int count = 0;
+    if (rows > 0 && cols > 0)
+    {
+        int sizes[2] = {N, N}, subsizes[2] = {rows, cols}, starts[2] = {row0, col0};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, element, &fileType);
+        MPI_Type_commit(&fileType);
+        MPI_Type_vector(rows, cols, ld, element, &memType);
+        MPI_Type_commit(&memType);
+        count = 1;
+    }
+    MPI_File_set_view(fh, sizeof(MatrixHeader), element, fileType, "native", MPI_INFO_NULL);
+    if (write)
+    {
+        MPI_File_write_at_all(fh, 0, buf, count, memType, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        MPI_File_read_at_all(fh, 0, buf, count, memType, MPI_STATUS_IGNORE);
+    }
+    if (count > 0)
+    {
+        MPI_Type_free(&fileType);
+        MPI_Type_free(&memType);
+    }
+}
+
+static void readBlock(const char *path, int N, int code, int row0, int rows, int col0, int cols,
+                      void *buf, int ld)
+{
+    MPI_File fh = openMatrix(path, MPI_MODE_RDONLY);
+    accessBlock(fh, N, code, row0, rows, col0, cols, buf, ld, 0);
+    MPI_File_close(&fh);
+}
+
+// Rank 0 writes the header, then every process writes its own block
+static void writeBlock(const char *path, int N, int code, int row0, int rows, int col0, int cols,
+                       const void *buf, int ld)
+{
+    int rank;
+    int32_t size = (int32_t)elementTypes[code].size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_File fh = openMatrix(path, MPI_MODE_CREATE | MPI_MODE_WRONLY);
+    MPI_File_set_size(fh, sizeof(MatrixHeader) + (MPI_Offset)N * N * size);
+    if (rank == 0)
+    {
+        MatrixHeader header = {MATRIX_MAGIC, N, N, code, size};
+        MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    accessBlock(fh, N, code, row0, rows, col0, cols, (void *)buf, ld, 1);
+    MPI_File_close(&fh);
+}
+
+// Rank 0 copies columns [j0, j0 + w) of the N x N matrix B into a contiguous N x w panel
+static void packPanel(const void *B, int N, int j0, int w, void *panel, size_t size)
+{
+    for (int i = 0; i < N; i++)
+    {
+        memcpy(ELEMENT(panel, (size_t)i * w, size), ELEMENT(B, (size_t)i * N + j0, size), w * size);
+    }
+}
+
+// Pipelined local multiply: B arrives in column panels of width panelWidth through
+// MPI_Ibcast into two alternating buffers. While panel j is multiplied, panel j + 1
+// is already in flight; the multiply is done in row blocks with an MPI_Test between
+// them so the broadcast keeps progressing. Returns the time spent waiting for panels.
+static double multiplyPipelined(const ElementType *type, const void *B, const void *subA, void *subC,
+                                int rows, int N, int panelWidth, int rank, double *computeTime)
+{
+    int panels = (N + panelWidth - 1) / panelWidth;
+    void *buffer[2];
+    MPI_Request request[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    double waitTime = 0.0, start;
+
+    buffer[0] = malloc((size_t)N * panelWidth * type->size);
+    buffer[1] = malloc((size_t)N * panelWidth * type->size);
+
+    for (int j = 0; j <= panels; j++)
+    {
+        // Start the broadcast of panel j, then finish and use panel j - 1
+        if (j < panels)
         {
-            fprintf(stderr, "N must be divisible by the number of processes.\n");
+            int w = N - j * panelWidth < panelWidth ? N - j * panelWidth : panelWidth;
+            if (rank == 0)
+            {
+                packPanel(B, N, j * panelWidth, w, buffer[j % 2], type->size);
+            }
+            MPI_Ibcast(buffer[j % 2], N * w, mpiType(type->code), 0, MPI_COMM_WORLD,
+                       &request[j % 2]);
         }
-        MPI_Abort(MPI_COMM_WORLD, 1);
+        if (j == 0)
+        {
+            continue;
+        }
+
+        int prev = j - 1;
+        int w = N - prev * panelWidth < panelWidth ? N - prev * panelWidth : panelWidth;
+        start = MPI_Wtime();
+        MPI_Wait(&request[prev % 2], MPI_STATUS_IGNORE);
+        waitTime += MPI_Wtime() - start;
+
+        start = MPI_Wtime();
+        for (int i = 0; i < rows; i += MC)
+        {
+            int mc = rows - i < MC ? rows - i : MC;
+            gemmParallel(type, mc, w, N, ELEMENT(subA, (size_t)i * N, type->size), N,
+                         buffer[prev % 2], w,
+                         ELEMENT(subC, (size_t)i * N + prev * panelWidth, type->accSize), N, 0);
+            if (j < panels)
+            {
+                int flag;
+                MPI_Test(&request[j % 2], &flag, MPI_STATUS_IGNORE);
+            }
+        }
+        *computeTime += MPI_Wtime() - start;
     }
 
-    int *A = NULL, *B = NULL, *C = NULL, *subA = NULL, *subC = NULL;
-    int rows = N / size; // Rows of A to send to each process
+    free(buffer[0]);
+    free(buffer[1]);
+    return waitTime;
+}
+
+// 1D row distribution: rank 0 scatters strips of rows of A, balanced for any N. B is
+// either broadcast whole before the multiply or, with pipelined set, streamed in
+// column panels that overlap with it, so no other process ever holds all of B.
+// With input files each process reads its own strip of A instead, and B is read by
+// every process (or only by rank 0 when it is streamed); each strip of C is written
+// straight to the output file, and C is only gathered on rank 0 to print it.
+static void multiplyRows(const ElementType *type, int N, int naive, int pipelined, int panelWidth,
+                         const MatrixIo *io, int rank, int size, double startTime)
+{
+    double computeStart, computeTime = 0.0, commStart, commTime;
+    MPI_Datatype element = mpiType(type->code), accElement = mpiType(type->accCode);
+
+    void *A = NULL, *B = NULL, *C = NULL, *subA = NULL, *subC = NULL;
+    int *counts = (int *)malloc(size * sizeof(int));
+    int *displs = (int *)malloc(size * sizeof(int));
+    rowSplit(N, size, counts, displs);
+    int rows = counts[rank] / N; // Rows of A sent to this process
+    int row0 = displs[rank] / N;
 
     // Master process initializes data and distributes it
-    if (rank == 0)
+    if (rank == 0 && io->print)
+    {
+        C = malloc((size_t)N * N * type->accSize);
+    }
+    if (rank == 0 && !io->pathA)
     {
-        A = (int *)malloc(N * N * sizeof(int));
-        B = (int *)malloc(N * N * sizeof(int));
-        C = (int *)malloc(N * N * sizeof(int));
+        A = malloc((size_t)N * N * type->size);
+        B = malloc((size_t)N * N * type->size);
         // Initialize matrices A and B with some values
         for (int i = 0; i < N * N; i++)
         {
-            A[i] = i + 1;
-            B[i] = (i + 1) * 2;
+            type->fill(A, i, i + 1);
+            type->fill(B, i, (i + 1) * 2LL);
         }
     }
 
-    // Allocate memory for sub-matrices and matrix B in all processes
-    subA = (int *)malloc(rows * N * sizeof(int));
-    subC = (int *)malloc(rows * N * sizeof(int));
-    if (rank != 0)
+    // Allocate memory for sub-matrices, and matrix B unless it is streamed
+    subA = malloc((size_t)rows * N * type->size);
+    subC = malloc((size_t)rows * N * type->accSize);
+    if (!B && (rank == 0 || !pipelined))
     {
-        B = (int *)malloc(N * N * sizeof(int));
+        B = malloc((size_t)N * N * type->size);
     }
 
-    // Distribute parts of matrix A and the whole of matrix B to all processes
-    MPI_Scatter(A, rows * N, MPI_INT, subA, rows * N, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(B, N * N, MPI_INT, 0, MPI_COMM_WORLD);
+    // Distribute parts of matrix A to all processes
+    commStart = MPI_Wtime();
+    if (io->pathA)
+    {
+        int rowsB = rank == 0 || !pipelined ? N : 0;
+        readBlock(io->pathA, N, type->code, row0, rows, 0, N, subA, N);
+        readBlock(io->pathB, N, type->code, 0, rowsB, 0, N, B, N);
+    }
+    else
+    {
+        MPI_Scatterv(A, counts, displs, element, subA, rows * N, element, 0, MPI_COMM_WORLD);
+        if (!pipelined)
+        {
+            MPI_Bcast(B, N * N, element, 0, MPI_COMM_WORLD);
+        }
+    }
+    commTime = MPI_Wtime() - commStart;
 
     // Perform local multiplication
-    multiplyMatrices(subA, B, subC, rows, N);
+    if (pipelined)
+    {
+        commTime += multiplyPipelined(type, B, subA, subC, rows, N, panelWidth, rank, &computeTime);
+    }
+    else
+    {
+        computeStart = MPI_Wtime();
+        if (naive)
+        {
+            type->naive(subA, B, subC, rows, N);
+        }
+        else
+        {
+            multiplyMatrices(type, subA, B, subC, rows, N);
+        }
+        computeTime = MPI_Wtime() - computeStart;
+    }
 
-    // Gather the computed parts of matrix C from all processes
-    MPI_Gather(subC, rows * N, MPI_INT, C, rows * N, MPI_INT, 0, MPI_COMM_WORLD);
+    // Write the computed parts of matrix C, and gather them only to print them
+    commStart = MPI_Wtime();
+    if (io->pathC)
+    {
+        writeBlock(io->pathC, N, type->accCode, row0, rows, 0, N, subC, N);
+    }
+    if (io->print)
+    {
+        MPI_Gatherv(subC, rows * N, accElement, C, counts, displs, accElement, 0, MPI_COMM_WORLD);
+    }
+    commTime += MPI_Wtime() - commStart;
 
     // End timing
-    endTime = MPI_Wtime();
+    double endTime = MPI_Wtime();
 
     // Master process prints the result
-    if (rank == 0)
+    if (rank == 0 && io->print)
     {
         printf("Result matrix C:\n");
         for (int i = 0; i < N; i++)
         {
             for (int j = 0; j < N; j++)
             {
-                printf("%d ", C[i * N + j]);
+                type->print(C, (size_t)i * N + j);
             }
             printf("\n");
         }
-        printf("Execution time: %f seconds\n", endTime - startTime);
-        free(A);
-        free(B);
-        free(C);
+    }
+    printTiming(N, size, endTime - startTime, computeTime, commTime);
+
+    free(A);
+    free(C);
+    free(B);
+    free(subA);
+    free(subC);
+    free(counts);
+    free(displs);
+}
+
+// 2D SUMMA on a q x q Cartesian process grid. The matrices are padded to q * nb
+// and each process holds only the nb x nb tiles of A, B and C at its grid
+// position, generated in place. At step k the processes in grid column k
+// broadcast their A tile along their grid row, the processes in grid row k
+// broadcast their B tile along their grid column, and every process adds the
+// product of the two tiles it received to its C tile.
+static void multiplySumma(const ElementType *type, int N, const MatrixIo *io, int rank, int size,
+                          double startTime)
+{
+    double computeStart, computeTime = 0.0, commStart, commTime = 0.0;
+    MPI_Datatype element = mpiType(type->code), accElement = mpiType(type->accCode);
+
+    int q = 0;
+    while ((q + 1) * (q + 1) <= size)
+    {
+        q++;
+    }
+    if (q * q != size)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "The SUMMA mode needs a square number of processes.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Grid ranks equal world ranks (no reordering), laid out row by row
+    MPI_Comm grid, rowComm, colComm;
+    int dims[2] = {q, q}, periods[2] = {0, 0}, coords[2];
+    int keepCols[2] = {0, 1}, keepRows[2] = {1, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+    MPI_Cart_coords(grid, rank, 2, coords);
+    MPI_Cart_sub(grid, keepCols, &rowComm); // Rank in rowComm is the grid column
+    MPI_Cart_sub(grid, keepRows, &colComm); // Rank in colComm is the grid row
+
+    int nb = (N + q - 1) / q;
+    size_t tileSize = (size_t)nb * nb;
+    void *tileA = malloc(tileSize * type->size);
+    void *tileB = malloc(tileSize * type->size);
+    void *tileC = malloc(tileSize * type->accSize);
+    void *bufA = malloc(tileSize * type->size);
+    void *bufB = malloc(tileSize * type->size);
+
+    // The part of this tile inside the N x N matrix; the rest is zero padding
+    int row0 = coords[0] * nb, col0 = coords[1] * nb;
+    int rowsIn = N - row0 < nb ? (N - row0 > 0 ? N - row0 : 0) : nb;
+    int colsIn = N - col0 < nb ? (N - col0 > 0 ? N - col0 : 0) : nb;
+
+    if (io->pathA)
+    {
+        memset(tileA, 0, tileSize * type->size);
+        memset(tileB, 0, tileSize * type->size);
+        commStart = MPI_Wtime();
+        readBlock(io->pathA, N, type->code, row0, rowsIn, col0, colsIn, tileA, nb);
+        readBlock(io->pathB, N, type->code, row0, rowsIn, col0, colsIn, tileB, nb);
+        commTime += MPI_Wtime() - commStart;
     }
     else
     {
-        free(B);
+        // Same values as the row mode, A[i][j] = i * N + j + 1 and B = 2 A
+        for (int i = 0; i < nb; i++)
+        {
+            for (int j = 0; j < nb; j++)
+            {
+                long long value = (long long)(row0 + i) * N + col0 + j + 1;
+                int inside = i < rowsIn && j < colsIn;
+                type->fill(tileA, (size_t)i * nb + j, inside ? value : 0);
+                type->fill(tileB, (size_t)i * nb + j, inside ? value * 2 : 0);
+            }
+        }
+    }
+
+    for (int k = 0; k < q; k++)
+    {
+        void *a = coords[1] == k ? tileA : bufA;
+        void *b = coords[0] == k ? tileB : bufB;
+        commStart = MPI_Wtime();
+        MPI_Bcast(a, nb * nb, element, k, rowComm);
+        MPI_Bcast(b, nb * nb, element, k, colComm);
+        commTime += MPI_Wtime() - commStart;
+
+        computeStart = MPI_Wtime();
+        gemmParallel(type, nb, nb, nb, a, nb, b, nb, tileC, nb, k > 0);
+        computeTime += MPI_Wtime() - computeStart;
+    }
+
+    if (io->pathC)
+    {
+        commStart = MPI_Wtime();
+        writeBlock(io->pathC, N, type->accCode, row0, rowsIn, col0, colsIn, tileC, nb);
+        commTime += MPI_Wtime() - commStart;
+    }
+
+    double endTime = MPI_Wtime();
+
+    // Rank 0 collects and prints one row of tiles at a time, so it never holds all of C
+    if (io->print)
+    {
+        if (rank == 0)
+        {
+            printf("Result matrix C:\n");
+        }
+        if (rank != 0)
+        {
+            MPI_Send(tileC, nb * nb, accElement, 0, 0, MPI_COMM_WORLD);
+        }
+        else
+        {
+            void *strip = malloc(tileSize * q * type->accSize);
+            for (int r = 0; r < q; r++)
+            {
+                for (int c = 0; c < q; c++)
+                {
+                    if (r == 0 && c == 0)
+                    {
+                        memcpy(strip, tileC, tileSize * type->accSize);
+                        continue;
+                    }
+                    MPI_Recv(ELEMENT(strip, c * tileSize, type->accSize), nb * nb, accElement,
+                             r * q + c, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                }
+                for (int i = 0; i < nb && r * nb + i < N; i++)
+                {
+                    for (int j = 0; j < N; j++)
+                    {
+                        type->print(strip, (size_t)(j / nb) * tileSize + (size_t)i * nb + j % nb);
+                    }
+                    printf("\n");
+                }
+            }
+            free(strip);
+        }
+    }
+    printTiming(N, size, endTime - startTime, computeTime, commTime);
+
+    free(tileA);
+    free(tileB);
+    free(tileC);
+    free(bufA);
+    free(bufB);
+    MPI_Comm_free(&rowComm);
+    MPI_Comm_free(&colComm);
+    MPI_Comm_free(&grid);
+}
+
+// Bump allocator over one preallocated block, for the Strassen temporaries. Each
+// recursion level takes its blocks and hands them back by resetting used.
+// Sizes are in elements of elementSize bytes.
+typedef struct
+{
+    char *base;
+    size_t size, used, elementSize;
+} Arena;
+
+static void *arenaAlloc(Arena *arena, size_t count)
+{
+    if (arena->used + count > arena->size)
+    {
+        fprintf(stderr, "Strassen workspace exhausted.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    void *block = ELEMENT(arena->base, arena->used, arena->elementSize);
+    arena->used += count;
+    return block;
+}
+
+static void copyBlock(int h, const void *X, int ldx, void *Z, int ldz, size_t size)
+{
+    for (int i = 0; i < h; i++)
+    {
+        memcpy(ELEMENT(Z, (size_t)i * ldz, size), ELEMENT(X, (size_t)i * ldx, size), h * size);
+    }
+}
+
+// Winograd's form of Strassen's algorithm, with h = n / 2 and the quadrants A11..B22:
+//   S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2
+//   T1 = B12 - B11, T2 = B22 - T1, T3 = B22 - B12, T4 = T2 - B21
+// The seven products are taken in the order
+//   A11 B11, A12 B21, S1 T1, S2 T2, S4 B22, A22 T4, S3 T3
+// so that S and T can each be updated in place, and product i is added to the
+// quadrants C11, C12, C21, C22 with the signs in strassenSigns[i]. All of the
+// Strassen functions work on one type throughout, whose add forms the sums.
+static const int strassenSigns[7][4] = {
+    {1, 1, 1, 1}, {1, 0, 0, 0}, {0, 1, 0, 1}, {0, 1, 1, 1}, {0, 1, 0, 0}, {0, 0, -1, 0}, {0, 0, 1, 1}};
+
+// Set up the operands X and Y of product i, updating the h x h blocks S and T
+static void strassenOperands(const ElementType *type, int i, int h, const void *A, int lda,
+                             const void *B, int ldb, void *S, void *T, const void **X, int *ldx,
+                             const void **Y, int *ldy)
+{
+    size_t size = type->size;
+    const void *A11 = A, *A12 = ELEMENT(A, h, size), *A21 = ELEMENT(A, (size_t)h * lda, size);
+    const void *A22 = ELEMENT(A21, h, size);
+    const void *B11 = B, *B12 = ELEMENT(B, h, size), *B21 = ELEMENT(B, (size_t)h * ldb, size);
+    const void *B22 = ELEMENT(B21, h, size);
+    void (*addBlock)(int, const void *, int, const void *, int, int, void *, int) = type->add;
+
+    *X = S;
+    *ldx = h;
+    *Y = T;
+    *ldy = h;
+    switch (i)
+    {
+    case 0:
+        *X = A11, *ldx = lda, *Y = B11, *ldy = ldb;
+        break;
+    case 1:
+        *X = A12, *ldx = lda, *Y = B21, *ldy = ldb;
+        break;
+    case 2:
+        addBlock(h, A21, lda, A22, lda, 1, S, h);  // S1
+        addBlock(h, B12, ldb, B11, ldb, -1, T, h); // T1
+        break;
+    case 3:
+        addBlock(h, S, h, A11, lda, -1, S, h);     // S2
+        addBlock(h, B22, ldb, T, h, -1, T, h);     // T2
+        break;
+    case 4:
+        addBlock(h, A12, lda, S, h, -1, S, h);     // S4
+        *Y = B22, *ldy = ldb;
+        break;
+    case 5:
+        addBlock(h, T, h, B21, ldb, -1, T, h);     // T4
+        *X = A22, *ldx = lda;
+        break;
+    case 6:
+        addBlock(h, A11, lda, A21, lda, -1, S, h); // S3
+        addBlock(h, B22, ldb, B12, ldb, -1, T, h); // T3
+        break;
+    }
+}
+
+// Add product i (h x h, contiguous) into the quadrants of C; product 0 sets them
+static void strassenCombine(const ElementType *type, int i, int h, const void *P, void *C, int ldc)
+{
+    size_t size = type->size;
+    void *quadrant[4] = {C, ELEMENT(C, h, size), ELEMENT(C, (size_t)h * ldc, size),
+                         ELEMENT(C, (size_t)h * ldc + h, size)};
+    for (int q = 0; q < 4; q++)
+    {
+        if (i == 0)
+        {
+            copyBlock(h, P, h, quadrant[q], ldc, size);
+        }
+        else if (strassenSigns[i][q] != 0)
+        {
+            type->add(h, quadrant[q], ldc, P, h, strassenSigns[i][q], quadrant[q], ldc);
+        }
+    }
+}
+
+// C = A * B for n x n blocks, recursing until n is at most cutoff (or odd) and then
+// using the blocked kernel. Each level takes three h x h blocks from the arena, so
+// the whole recursion needs at most n * n elements of workspace.
+static void strassenLocal(const ElementType *type, int n, const void *A, int lda, const void *B,
+                          int ldb, void *C, int ldc, int cutoff, Arena *arena)
+{
+    if (n <= cutoff || n % 2 != 0)
+    {
+        gemmParallel(type, n, n, n, A, lda, B, ldb, C, ldc, 0);
+        return;
+    }
+
+    int h = n / 2;
+    size_t mark = arena->used;
+    void *S = arenaAlloc(arena, (size_t)h * h);
+    void *T = arenaAlloc(arena, (size_t)h * h);
+    void *P = arenaAlloc(arena, (size_t)h * h);
+
+    for (int i = 0; i < 7; i++)
+    {
+        const void *X, *Y;
+        int ldx, ldy;
+        strassenOperands(type, i, h, A, lda, B, ldb, S, T, &X, &ldx, &Y, &ldy);
+        strassenLocal(type, h, X, ldx, Y, ldy, P, h, cutoff, arena);
+        strassenCombine(type, i, h, P, C, ldc);
+    }
+
+    arena->used = mark;
+}
+
+// Expand depth levels of the recursion without multiplying: the operands of the
+// 7^depth leaf products are copied, in depth-first order, to leavesA and leavesB
+static void strassenSplit(const ElementType *type, int n, const void *A, int lda, const void *B,
+                          int ldb, int depth, void *leavesA, void *leavesB, int *next, Arena *arena)
+{
+    if (depth == 0)
+    {
+        copyBlock(n, A, lda, ELEMENT(leavesA, (size_t)*next * n * n, type->size), n, type->size);
+        copyBlock(n, B, ldb, ELEMENT(leavesB, (size_t)*next * n * n, type->size), n, type->size);
+        (*next)++;
+        return;
+    }
+
+    int h = n / 2;
+    size_t mark = arena->used;
+    void *S = arenaAlloc(arena, (size_t)h * h);
+    void *T = arenaAlloc(arena, (size_t)h * h);
+
+    for (int i = 0; i < 7; i++)
+    {
+        const void *X, *Y;
+        int ldx, ldy;
+        strassenOperands(type, i, h, A, lda, B, ldb, S, T, &X, &ldx, &Y, &ldy);
+        strassenSplit(type, h, X, ldx, Y, ldy, depth - 1, leavesA, leavesB, next, arena);
+    }
+
+    arena->used = mark;
+}
+
+// Combine the leaf products of strassenSplit, in the same order, into C
+static void strassenMerge(const ElementType *type, int n, const void *leavesC, int *next, int depth,
+                          void *C, int ldc, Arena *arena)
+{
+    if (depth == 0)
+    {
+        copyBlock(n, ELEMENT(leavesC, (size_t)*next * n * n, type->size), n, C, ldc, type->size);
+        (*next)++;
+        return;
+    }
+
+    int h = n / 2;
+    size_t mark = arena->used;
+    void *P = arenaAlloc(arena, (size_t)h * h);
+
+    for (int i = 0; i < 7; i++)
+    {
+        strassenMerge(type, h, leavesC, next, depth - 1, P, h, arena);
+        strassenCombine(type, i, h, P, C, ldc);
+    }
+
+    arena->used = mark;
+}
+
+// Strassen-Winograd multiply. N is padded with zeros to M = m0 * 2^levels, where
+// m0 <= cutoff is where the recursion hands over to the blocked kernel. Rank 0
+// expands the top depth levels into 7^depth products, with depth just large
+// enough to give every process work, and deals them out round-robin; each
+// process multiplies its products with strassenLocal and sends them back. With -wide
+// the inputs are widened first, since the sums S and T need the wider type as well.
+static void multiplyStrassen(const ElementType *type, int N, int cutoff, const MatrixIo *io,
+                             int rank, int size, double startTime)
+{
+    double computeStart, computeTime = 0.0, commStart, commTime = 0.0;
+    const ElementType *acc = &elementTypes[type->accCode];
+    size_t accSize = acc->size;
+    MPI_Datatype element = mpiType(acc->code);
+
+    int levels = 0;
+    while ((N + (1 << levels) - 1) >> levels > cutoff)
+    {
+        levels++;
+    }
+    int M = ((N + (1 << levels) - 1) >> levels) << levels;
+    int depth = 0, tasks = 1;
+    while (depth < levels && tasks < size)
+    {
+        depth++;
+        tasks *= 7;
+    }
+    int h = M >> depth; // Size of the distributed products
+    size_t leafSize = (size_t)h * h;
+
+    Arena arena;
+    arena.size = leafSize + (rank == 0 ? (size_t)M * M : 0);
+    arena.used = 0;
+    arena.elementSize = accSize;
+    arena.base = (char *)malloc(arena.size * accSize);
+
+    void *A = NULL, *B = NULL, *C = NULL, *leavesA = NULL, *leavesB = NULL, *leavesC = NULL;
+    int next;
+
+    if (rank == 0)
+    {
+        printf("Strassen-Winograd: padded to %d, %d levels above the cutoff, %d products distributed\n",
+               M, levels, tasks);
+        A = calloc((size_t)M * M, accSize);
+        B = calloc((size_t)M * M, accSize);
+        C = malloc((size_t)M * M * accSize);
+    }
+    if (io->pathA)
+    {
+        // Only rank 0 holds the operands; the others join the collective reads empty-handed
+        void *rows = rank == 0 ? malloc((size_t)N * N * type->size) : NULL;
+        commStart = MPI_Wtime();
+        for (int m = 0; m < 2; m++)
+        {
+            readBlock(m == 0 ? io->pathA : io->pathB, N, type->code, 0, rank == 0 ? N : 0, 0, N,
+                      rows, N);
+            for (int i = 0; i < N && rank == 0; i++)
+            {
+                type->convert(ELEMENT(rows, (size_t)i * N, type->size),
+                              ELEMENT(m == 0 ? A : B, (size_t)i * M, accSize), N);
+            }
+        }
+        commTime += MPI_Wtime() - commStart;
+        free(rows);
+    }
+    else if (rank == 0)
+    {
+        // Same values as the row mode
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                acc->fill(A, (size_t)i * M + j, (long long)i * N + j + 1);
+                acc->fill(B, (size_t)i * M + j, ((long long)i * N + j + 1) * 2);
+            }
+        }
+    }
+
+    if (rank == 0)
+    {
+        leavesA = malloc(tasks * leafSize * accSize);
+        leavesB = malloc(tasks * leafSize * accSize);
+        leavesC = malloc(tasks * leafSize * accSize);
+
+        computeStart = MPI_Wtime();
+        next = 0;
+        strassenSplit(acc, M, A, M, B, M, depth, leavesA, leavesB, &next, &arena);
+        computeTime += MPI_Wtime() - computeStart;
+
+        commStart = MPI_Wtime();
+        MPI_Request *requests = (MPI_Request *)malloc(2 * tasks * sizeof(MPI_Request));
+        int sent = 0;
+        for (int t = 0; t < tasks; t++)
+        {
+            if (t % size != 0)
+            {
+                MPI_Isend(ELEMENT(leavesA, t * leafSize, accSize), (int)leafSize, element, t % size,
+                          2 * t, MPI_COMM_WORLD, &requests[sent++]);
+                MPI_Isend(ELEMENT(leavesB, t * leafSize, accSize), (int)leafSize, element, t % size,
+                          2 * t + 1, MPI_COMM_WORLD, &requests[sent++]);
+            }
+        }
+        commTime += MPI_Wtime() - commStart;
+
+        computeStart = MPI_Wtime();
+        for (int t = 0; t < tasks; t += size)
+        {
+            strassenLocal(acc, h, ELEMENT(leavesA, t * leafSize, accSize), h,
+                          ELEMENT(leavesB, t * leafSize, accSize), h,
+                          ELEMENT(leavesC, t * leafSize, accSize), h, cutoff, &arena);
+        }
+        computeTime += MPI_Wtime() - computeStart;
+
+        commStart = MPI_Wtime();
+        for (int t = 0; t < tasks; t++)
+        {
+            if (t % size != 0)
+            {
+                MPI_Recv(ELEMENT(leavesC, t * leafSize, accSize), (int)leafSize, element, t % size,
+                         t, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            }
+        }
+        MPI_Waitall(sent, requests, MPI_STATUSES_IGNORE);
+        free(requests);
+        commTime += MPI_Wtime() - commStart;
+
+        computeStart = MPI_Wtime();
+        next = 0;
+        strassenMerge(acc, M, leavesC, &next, depth, C, M, &arena);
+        computeTime += MPI_Wtime() - computeStart;
+    }
+    else
+    {
+        void *a = malloc(leafSize * accSize);
+        void *b = malloc(leafSize * accSize);
+        void *c = malloc(leafSize * accSize);
+        for (int t = rank; t < tasks; t += size)
+        {
+            commStart = MPI_Wtime();
+            MPI_Recv(a, (int)leafSize, element, 0, 2 * t, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(b, (int)leafSize, element, 0, 2 * t + 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            commTime += MPI_Wtime() - commStart;
+
+            computeStart = MPI_Wtime();
+            strassenLocal(acc, h, a, h, b, h, c, h, cutoff, &arena);
+            computeTime += MPI_Wtime() - computeStart;
+
+            commStart = MPI_Wtime();
+            MPI_Send(c, (int)leafSize, element, 0, t, MPI_COMM_WORLD);
+            commTime += MPI_Wtime() - commStart;
+        }
+        free(a);
+        free(b);
+        free(c);
+    }
+
+    if (io->pathC)
+    {
+        commStart = MPI_Wtime();
+        writeBlock(io->pathC, N, acc->code, 0, rank == 0 ? N : 0, 0, N, C, M);
+        commTime += MPI_Wtime() - commStart;
+    }
+
+    double endTime = MPI_Wtime();
+
+    if (rank == 0 && io->print)
+    {
+        printf("Result matrix C:\n");
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                acc->print(C, (size_t)i * M + j);
+            }
+            printf("\n");
+        }
+    }
+    printTiming(N, size, endTime - startTime, computeTime, commTime);
+
+    free(A);
+    free(B);
+    free(C);
+    free(leavesA);
+    free(leavesB);
+    free(leavesC);
+    free(arena.base);
+}
+
+// Sparse engine. Each process holds a block of consecutive rows in CSR form, split
+// the same way as rowSplit: process p starts at row blockStart(n, size, p).
+static int blockStart(int n, int size, int p)
+{
+    return p * (n / size) + (p < n % size ? p : n % size);
+}
+
+// Process that holds row r of n
+static int blockOwner(int n, int size, int r)
+{
+    int base = n / size, extra = n % size;
+    if (r < extra * (base + 1))
+    {
+        return r / (base + 1);
+    }
+    return extra + (r - extra * (base + 1)) / base;
+}
+
+// Local rows of a sparse matrix. colIdx holds global column indices until
+// buildHalo renumbers them to positions in the local vector plus ghosts.
+typedef struct
+{
+    int rows;    // Local rows
+    int row0;    // First global row
+    int n;       // Global rows
+    int cols;    // Global columns
+    int nnz;     // Local nonzeros
+    int *rowPtr; // rows + 1 offsets into colIdx and val
+    int *colIdx;
+    double *val;
+} Csr;
+
+static void csrFree(Csr *A)
+{
+    free(A->rowPtr);
+    free(A->colIdx);
+    free(A->val);
+}
+
+// Longest Matrix Market entry line a process reads past the end of its byte range
+#define MM_LINE_MAX 256
+
+// Growable coordinate list
+typedef struct
+{
+    int count, capacity;
+    int *i, *j;
+    double *v;
+} Triples;
+
+static void triplesAdd(Triples *t, int i, int j, double v)
+{
+    if (t->count == t->capacity)
+    {
+        t->capacity = t->capacity ? 2 * t->capacity : 1024;
+        t->i = (int *)realloc(t->i, t->capacity * sizeof(int));
+        t->j = (int *)realloc(t->j, t->capacity * sizeof(int));
+        t->v = (double *)realloc(t->v, t->capacity * sizeof(double));
+    }
+    t->i[t->count] = i;
+    t->j[t->count] = j;
+    t->v[t->count] = v;
+    t->count++;
+}
+
+// Read a coordinate Matrix Market file (real, integer or pattern; general, symmetric
+// or skew-symmetric) into row blocks. Rank 0 parses the banner and size line. Then
+// every process reads an equal byte range of the entries with one collective read,
+// parses the lines that start inside it, and sends each entry to the owner of its row.
+static void readMatrixMarket(const char *path, int rank, int size, Csr *A)
+{
+    long long info[6] = {-1}; // rows, cols, entries, data offset, pattern, symmetry
+    if (rank == 0)
+    {
+        FILE *f = fopen(path, "r");
+        char line[1024], object[64], format[64], field[64], symmetry[64];
+        if (f && fgets(line, sizeof(line), f) &&
+            sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) == 4 &&
+            strcasecmp(object, "matrix") == 0 && strcasecmp(format, "coordinate") == 0 &&
+            strcasecmp(field, "complex") != 0 && strcasecmp(symmetry, "hermitian") != 0)
+        {
+            while (fgets(line, sizeof(line), f) && (line[0] == '%' || line[0] == '\n'))
+            {
+            }
+            if (sscanf(line, "%lld %lld %lld", &info[0], &info[1], &info[2]) == 3)
+            {
+                info[3] = ftell(f);
+                info[4] = strcasecmp(field, "pattern") == 0;
+                info[5] = strcasecmp(symmetry, "symmetric") == 0        ? 1
+                          : strcasecmp(symmetry, "skew-symmetric") == 0 ? -1
+                                                                         : 0;
+            }
+        }
+        if (f)
+        {
+            fclose(f);
+        }
+    }
+    MPI_Bcast(info, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (info[0] <= 0 || info[1] <= 0 || info[0] > 2147483647 || info[1] > 2147483647)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "%s is not a real coordinate Matrix Market file\n", path);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    A->n = (int)info[0];
+    A->cols = (int)info[1];
+    A->row0 = blockStart(A->n, size, rank);
+    A->rows = blockStart(A->n, size, rank + 1) - A->row0;
+
+    // This process parses the lines starting in [lo, hi); it reads one byte before lo to
+    // see whether a line starts at lo, and up to MM_LINE_MAX bytes past hi to finish the last
+    MPI_File fh = openMatrix(path, MPI_MODE_RDONLY);
+    MPI_Offset fileSize;
+    MPI_File_get_size(fh, &fileSize);
+    MPI_Offset data = info[3], lo = data + (fileSize - data) * rank / size;
+    MPI_Offset hi = data + (fileSize - data) * (rank + 1) / size;
+    MPI_Offset end = hi + MM_LINE_MAX < fileSize ? hi + MM_LINE_MAX : fileSize;
+    int length = (int)(end - (lo - 1));
+    char *text = (char *)malloc(length + 1);
+    MPI_File_read_at_all(fh, lo - 1, text, length, MPI_CHAR, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    text[length] = '\0';
+
+    Triples mine = {0};
+    char *p = text + 1, *stop = text + 1 + (hi - lo);
+    if (text[0] != '\n')
+    {
+        while (p < stop && *p++ != '\n')
+        {
+        }
+    }
+    while (p < stop)
+    {
+        char *eol = strchr(p, '\n');
+        if (!eol && end < fileSize)
+        {
+            fprintf(stderr, "%s: entry line longer than %d bytes\n", path, MM_LINE_MAX);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        while (*p == ' ' || *p == '\t')
+        {
+            p++;
+        }
+        if (*p != '\n' && *p != '\r' && *p != '%' && *p != '\0')
+        {
+            long i = strtol(p, &p, 10) - 1;
+            long j = strtol(p, &p, 10) - 1;
+            double v = info[4] ? 1.0 : strtod(p, &p);
+            if (i < 0 || i >= A->n || j < 0 || j >= A->cols)
+            {
+                fprintf(stderr, "%s: entry (%ld, %ld) out of range\n", path, i + 1, j + 1);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            triplesAdd(&mine, i, j, v);
+            if (info[5] != 0 && i != j)
+            {
+                triplesAdd(&mine, j, i, info[5] * v);
+            }
+        }
+        p = eol ? eol + 1 : stop;
+    }
+    free(text);
+
+    // Send every entry to the owner of its row
+    int *sendCounts = (int *)calloc(size, sizeof(int));
+    int *sendDispls = (int *)malloc(size * sizeof(int));
+    int *recvCounts = (int *)malloc(size * sizeof(int));
+    int *recvDispls = (int *)malloc(size * sizeof(int));
+    for (int e = 0; e < mine.count; e++)
+    {
+        sendCounts[blockOwner(A->n, size, mine.i[e])]++;
+    }
+    MPI_Alltoall(sendCounts, 1, MPI_INT, recvCounts, 1, MPI_INT, MPI_COMM_WORLD);
+    int sendTotal = 0, recvTotal = 0;
+    for (int r = 0; r < size; r++)
+    {
+        sendDispls[r] = sendTotal;
+        recvDispls[r] = recvTotal;
+        sendTotal += sendCounts[r];
+        recvTotal += recvCounts[r];
+    }
+    Triples sorted = {.count = sendTotal, .capacity = sendTotal};
+    sorted.i = (int *)malloc(sendTotal * sizeof(int) + 1);
+    sorted.j = (int *)malloc(sendTotal * sizeof(int) + 1);
+    sorted.v = (double *)malloc(sendTotal * sizeof(double) + 1);
+    for (int e = 0; e < mine.count; e++)
+    {
+        int slot = sendDispls[blockOwner(A->n, size, mine.i[e])]++;
+        sorted.i[slot] = mine.i[e];
+        sorted.j[slot] = mine.j[e];
+        sorted.v[slot] = mine.v[e];
+    }
+    for (int r = 0; r < size; r++)
+    {
+        sendDispls[r] -= sendCounts[r];
+    }
+    free(mine.i);
+    free(mine.j);
+    free(mine.v);
+
+    int *rowsIn = (int *)malloc(recvTotal * sizeof(int) + 1);
+    int *colsIn = (int *)malloc(recvTotal * sizeof(int) + 1);
+    double *valsIn = (double *)malloc(recvTotal * sizeof(double) + 1);
+    MPI_Alltoallv(sorted.i, sendCounts, sendDispls, MPI_INT, rowsIn, recvCounts, recvDispls, MPI_INT,
+                  MPI_COMM_WORLD);
+    MPI_Alltoallv(sorted.j, sendCounts, sendDispls, MPI_INT, colsIn, recvCounts, recvDispls, MPI_INT,
+                  MPI_COMM_WORLD);
+    MPI_Alltoallv(sorted.v, sendCounts, sendDispls, MPI_DOUBLE, valsIn, recvCounts, recvDispls,
+                  MPI_DOUBLE, MPI_COMM_WORLD);
+    free(sorted.i);
+    free(sorted.j);
+    free(sorted.v);
+
+    // Counting sort by row into CSR
+    A->nnz = recvTotal;
+    A->rowPtr = (int *)calloc(A->rows + 1, sizeof(int));
+    A->colIdx = (int *)malloc(recvTotal * sizeof(int) + 1);
+    A->val = (double *)malloc(recvTotal * sizeof(double) + 1);
+    for (int e = 0; e < recvTotal; e++)
+    {
+        A->rowPtr[rowsIn[e] - A->row0 + 1]++;
+    }
+    for (int i = 0; i < A->rows; i++)
+    {
+        A->rowPtr[i + 1] += A->rowPtr[i];
+    }
+    for (int e = 0; e < recvTotal; e++)
+    {
+        int slot = A->rowPtr[rowsIn[e] - A->row0]++;
+        A->colIdx[slot] = colsIn[e];
+        A->val[slot] = valsIn[e];
+    }
+    for (int i = A->rows; i > 0; i--)
+    {
+        A->rowPtr[i] = A->rowPtr[i - 1];
+    }
+    A->rowPtr[0] = 0;
+
+    free(rowsIn);
+    free(colsIn);
+    free(valsIn);
+    free(sendCounts);
+    free(sendDispls);
+    free(recvCounts);
+    free(recvDispls);
+}
+
+// Communication plan for the remote entries of a vector (or rows of a matrix) that is
+// split over the processes like the columns of A. Only the entries that the local rows
+// of A actually use are exchanged, and only with the processes that hold them.
+typedef struct
+{
+    int local;       // Entries held here; ghosts follow them in the extended vector
+    int ghosts;      // Remote entries used here
+    int *ghostCols;  // Their global indices, ascending, so grouped by owner
+    int *recvCounts; // Per process, ghosts received from it, in ghostCols order
+    int *recvDispls;
+    int *sendCounts; // Per process, local entries it needs
+    int *sendDispls;
+    int *sendIdx;    // Those entries, as local indices
+    int *localEnd;   // Per row of A, end of the entries with local columns
+} Halo;
+
+static int compareInt(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Build the plan for A and renumber A's columns: local columns become 0 .. local - 1
+// and remote ones local + their position in ghostCols. Each row is reordered to put
+// its local columns first, so the multiply can start on them before the ghosts arrive.
+static void buildHalo(Csr *A, int rank, int size, Halo *h)
+{
+    int col0 = blockStart(A->cols, size, rank);
+    h->local = blockStart(A->cols, size, rank + 1) - col0;
+
+    int *remote = (int *)malloc(A->nnz * sizeof(int) + 1);
+    int count = 0;
+    for (int e = 0; e < A->nnz; e++)
+    {
+        if (A->colIdx[e] < col0 || A->colIdx[e] >= col0 + h->local)
+        {
+            remote[count++] = A->colIdx[e];
+        }
+    }
+    qsort(remote, count, sizeof(int), compareInt);
+    h->ghosts = 0;
+    for (int e = 0; e < count; e++)
+    {
+        if (h->ghosts == 0 || remote[e] != remote[h->ghosts - 1])
+        {
+            remote[h->ghosts++] = remote[e];
+        }
+    }
+    h->ghostCols = remote;
+
+    h->recvCounts = (int *)calloc(size, sizeof(int));
+    h->recvDispls = (int *)malloc(size * sizeof(int));
+    h->sendCounts = (int *)malloc(size * sizeof(int));
+    h->sendDispls = (int *)malloc(size * sizeof(int));
+    for (int g = 0; g < h->ghosts; g++)
+    {
+        h->recvCounts[blockOwner(A->cols, size, remote[g])]++;
+    }
+    MPI_Alltoall(h->recvCounts, 1, MPI_INT, h->sendCounts, 1, MPI_INT, MPI_COMM_WORLD);
+    int sendTotal = 0, recvTotal = 0;
+    for (int r = 0; r < size; r++)
+    {
+        h->sendDispls[r] = sendTotal;
+        h->recvDispls[r] = recvTotal;
+        sendTotal += h->sendCounts[r];
+        recvTotal += h->recvCounts[r];
+    }
+    h->sendIdx = (int *)malloc(sendTotal * sizeof(int) + 1);
+    MPI_Alltoallv(remote, h->recvCounts, h->recvDispls, MPI_INT, h->sendIdx, h->sendCounts,
+                  h->sendDispls, MPI_INT, MPI_COMM_WORLD);
+    for (int e = 0; e < sendTotal; e++)
+    {
+        h->sendIdx[e] -= col0;
+    }
+
+    // Renumber, and move the local columns of each row to the front
+    h->localEnd = (int *)malloc(A->rows * sizeof(int) + 1);
+    for (int i = 0; i < A->rows; i++)
+    {
+        int front = A->rowPtr[i];
+        for (int e = A->rowPtr[i]; e < A->rowPtr[i + 1]; e++)
+        {
+            int c = A->colIdx[e];
+            if (c >= col0 && c < col0 + h->local)
+            {
+                c -= col0;
+            }
+            else
+            {
+                int *ghost = (int *)bsearch(&c, remote, h->ghosts, sizeof(int), compareInt);
+                c = h->local + (int)(ghost - remote);
+            }
+            A->colIdx[e] = c;
+            if (c < h->local)
+            {
+                double v = A->val[e];
+                A->colIdx[e] = A->colIdx[front];
+                A->val[e] = A->val[front];
+                A->colIdx[front] = c;
+                A->val[front] = v;
+                front++;
+            }
+        }
+        h->localEnd[i] = front;
+    }
+}
+
+static void haloFree(Halo *h)
+{
+    free(h->ghostCols);
+    free(h->recvCounts);
+    free(h->recvDispls);
+    free(h->sendCounts);
+    free(h->sendDispls);
+    free(h->sendIdx);
+    free(h->localEnd);
+}
+
+// Start the ghost exchange of x (local entries, then room for the ghosts) with
+// point-to-point messages to the neighbours only. Returns the number of requests.
+static int haloStart(const Halo *h, double *x, double *sendBuf, int size, MPI_Request *requests)
+{
+    int count = 0;
+    for (int r = 0; r < size; r++)
+    {
+        if (h->recvCounts[r] > 0)
+        {
+            MPI_Irecv(x + h->local + h->recvDispls[r], h->recvCounts[r], MPI_DOUBLE, r, 0,
+                      MPI_COMM_WORLD, &requests[count++]);
+        }
+    }
+    for (int r = 0; r < size; r++)
+    {
+        if (h->sendCounts[r] > 0)
+        {
+            for (int e = h->sendDispls[r]; e < h->sendDispls[r] + h->sendCounts[r]; e++)
+            {
+                sendBuf[e] = x[h->sendIdx[e]];
+            }
+            MPI_Isend(sendBuf + h->sendDispls[r], h->sendCounts[r], MPI_DOUBLE, r, 0,
+                      MPI_COMM_WORLD, &requests[count++]);
+        }
+    }
+    return count;
+}
+
+// Rank 0 prints the slowest process's times and the aggregate rate
+static void printSparseTiming(double elapsed, double computeTime, double commTime, double flops)
+{
+    double times[2] = {computeTime, commTime}, timesMax[2], flopsTotal;
+    MPI_Reduce(times, timesMax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&flops, &flopsTotal, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0)
+    {
+        printf("Execution time: %f seconds\n", elapsed);
+        printf("Communication: %f seconds, computation: %f seconds\n", timesMax[1], timesMax[0]);
+        printf("Sparse multiply: %.2f GFLOP/s total\n", flopsTotal / timesMax[0] * 1e-9);
+    }
+}
+
+// y = A x, iters times, with A read from a Matrix Market file and x[j] = j % 10 + 1.
+// x and y are split over the processes like the columns and rows of A. Each product
+// first uses the local entries of x while the ghost entries are in flight.
+static void multiplySparseVector(const MatrixIo *io, int iters, int rank, int size,
+                                 double startTime)
+{
+    double computeStart, computeTime = 0.0, commStart, commTime = 0.0;
+
+    Csr A;
+    Halo h;
+    commStart = MPI_Wtime();
+    readMatrixMarket(io->pathA, rank, size, &A);
+    buildHalo(&A, rank, size, &h);
+    commTime += MPI_Wtime() - commStart;
+
+    long long nnz = A.nnz, nnzTotal, ghosts = h.ghosts, ghostsTotal;
+    MPI_Reduce(&nnz, &nnzTotal, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&ghosts, &ghostsTotal, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        printf("SpMV: %d x %d, %lld nonzeros, %lld ghost entries of x exchanged per product\n", A.n,
+               A.cols, nnzTotal, ghostsTotal);
+    }
+
+    int col0 = blockStart(A.cols, size, rank);
+    double *x = (double *)malloc((h.local + h.ghosts) * sizeof(double) + 1);
+    double *y = (double *)malloc(A.rows * sizeof(double) + 1);
+    int sendTotal = h.sendDispls[size - 1] + h.sendCounts[size - 1];
+    double *sendBuf = (double *)malloc(sendTotal * sizeof(double) + 1);
+    MPI_Request *requests = (MPI_Request *)malloc(2 * size * sizeof(MPI_Request));
+    for (int j = 0; j < h.local; j++)
+    {
+        x[j] = (col0 + j) % 10 + 1;
+    }
+
+    for (int it = 0; it < iters; it++)
+    {
+        commStart = MPI_Wtime();
+        int pending = haloStart(&h, x, sendBuf, size, requests);
+        commTime += MPI_Wtime() - commStart;
+
+        computeStart = MPI_Wtime();
+        for (int i = 0; i < A.rows; i++)
+        {
+            double sum = 0.0;
+            for (int e = A.rowPtr[i]; e < h.localEnd[i]; e++)
+            {
+                sum += A.val[e] * x[A.colIdx[e]];
+            }
+            y[i] = sum;
+        }
+        computeTime += MPI_Wtime() - computeStart;
+
+        commStart = MPI_Wtime();
+        MPI_Waitall(pending, requests, MPI_STATUSES_IGNORE);
+        commTime += MPI_Wtime() - commStart;
+
+        computeStart = MPI_Wtime();
+        for (int i = 0; i < A.rows; i++)
+        {
+            double sum = 0.0;
+            for (int e = h.localEnd[i]; e < A.rowPtr[i + 1]; e++)
+            {
+                sum += A.val[e] * x[A.colIdx[e]];
+            }
+            y[i] += sum;
+        }
+        computeTime += MPI_Wtime() - computeStart;
+    }
+
+    double endTime = MPI_Wtime();
+
+    double local = 0.0, checksum;
+    for (int i = 0; i < A.rows; i++)
+    {
+        local += y[i];
+    }
+    MPI_Reduce(&local, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (io->print)
+    {
+        int *counts = (int *)malloc(size * sizeof(int));
+        int *displs = (int *)malloc(size * sizeof(int));
+        for (int r = 0; r < size; r++)
+        {
+            displs[r] = blockStart(A.n, size, r);
+            counts[r] = blockStart(A.n, size, r + 1) - displs[r];
+        }
+        double *all = rank == 0 ? (double *)malloc((size_t)A.n * sizeof(double)) : NULL;
+        MPI_Gatherv(y, A.rows, MPI_DOUBLE, all, counts, displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0)
+        {
+            printf("Result vector y:\n");
+            for (int i = 0; i < A.n; i++)
+            {
+                printf("%.17g\n", all[i]);
+            }
+        }
+        free(all);
+        free(counts);
+        free(displs);
+    }
+    if (rank == 0)
+    {
+        printf("Sum of y: %.17g\n", checksum);
+    }
+    printSparseTiming(endTime - startTime, computeTime, commTime, 2.0 * A.nnz * iters);
+
+    free(x);
+    free(y);
+    free(sendBuf);
+    free(requests);
+    haloFree(&h);
+    csrFree(&A);
+}
+
+// Write a distributed CSR matrix as a Matrix Market file: every process formats its
+// rows as text and writes them at its offset, found with MPI_Exscan, in one collective write.
+static void writeMatrixMarket(const char *path, const Csr *C, int rank)
+{
+    long long nnz = C->nnz, nnzTotal;
+    MPI_Allreduce(&nnz, &nnzTotal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    size_t capacity = (size_t)C->nnz * 48 + 128, used = 0;
+    char *text = (char *)malloc(capacity);
+    if (rank == 0)
+    {
+        used += sprintf(text, "%%%%MatrixMarket matrix coordinate real general\n%d %d %lld\n", C->n,
+                        C->cols, nnzTotal);
+    }
+    for (int i = 0; i < C->rows; i++)
+    {
+        for (int e = C->rowPtr[i]; e < C->rowPtr[i + 1]; e++)
+        {
+            used += sprintf(text + used, "%d %d %.17g\n", C->row0 + i + 1, C->colIdx[e] + 1, C->val[e]);
+        }
+    }
+
+    long long length = used, offset = 0, total;
+    MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&length, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        offset = 0;
+    }
+    MPI_File fh = openMatrix(path, MPI_MODE_CREATE | MPI_MODE_WRONLY);
+    MPI_File_set_size(fh, total);
+    MPI_File_write_at_all(fh, offset, text, (int)used, MPI_CHAR, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+    free(text);
+}
+
+// C = A B, with A and B read from Matrix Market files (B = A if none is given). C
+// takes the row split of A, and B the same split over its rows as the columns of A,
+// so the local rows of A only need the rows of B named by their remote columns. Those
+// rows are fetched once, then each row of C is formed with Gustavson's algorithm in
+// a dense accumulator over the columns of B.
+static void multiplySparse(const MatrixIo *io, int rank, int size, double startTime)
+{
+    double computeStart, computeTime = 0.0, commStart, commTime = 0.0;
+
+    Csr A, B;
+    Halo h;
+    commStart = MPI_Wtime();
+    readMatrixMarket(io->pathA, rank, size, &A);
+    readMatrixMarket(io->pathB ? io->pathB : io->pathA, rank, size, &B);
+    if (A.cols != B.n)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "A is %d x %d but B has %d rows.\n", A.n, A.cols, B.n);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    buildHalo(&A, rank, size, &h);
+
+    // Fetch the ghost rows of B: their lengths first, then their entries
+    int sendTotal = h.sendDispls[size - 1] + h.sendCounts[size - 1];
+    int *sendLengths = (int *)malloc(sendTotal * sizeof(int) + 1);
+    int *ghostPtr = (int *)calloc(h.ghosts + 1, sizeof(int));
+    int *sendCounts = (int *)malloc(size * sizeof(int));
+    int *sendDispls = (int *)malloc(size * sizeof(int));
+    int *recvCounts = (int *)malloc(size * sizeof(int));
+    int *recvDispls = (int *)malloc(size * sizeof(int));
+    for (int e = 0; e < sendTotal; e++)
+    {
+        sendLengths[e] = B.rowPtr[h.sendIdx[e] + 1] - B.rowPtr[h.sendIdx[e]];
+    }
+    MPI_Alltoallv(sendLengths, h.sendCounts, h.sendDispls, MPI_INT, ghostPtr + 1, h.recvCounts,
+                  h.recvDispls, MPI_INT, MPI_COMM_WORLD);
+    for (int g = 0; g < h.ghosts; g++)
+    {
+        ghostPtr[g + 1] += ghostPtr[g];
+    }
+    int sendEntries = 0;
+    for (int r = 0; r < size; r++)
+    {
+        sendDispls[r] = sendEntries;
+        for (int e = h.sendDispls[r]; e < h.sendDispls[r] + h.sendCounts[r]; e++)
+        {
+            sendEntries += sendLengths[e];
+        }
+        sendCounts[r] = sendEntries - sendDispls[r];
+        recvDispls[r] = ghostPtr[h.recvDispls[r]];
+        recvCounts[r] = ghostPtr[h.recvDispls[r] + h.recvCounts[r]] - recvDispls[r];
+    }
+    int *sendCols = (int *)malloc(sendEntries * sizeof(int) + 1);
+    double *sendVals = (double *)malloc(sendEntries * sizeof(double) + 1);
+    for (int e = 0, slot = 0; e < sendTotal; e++)
+    {
+        for (int k = B.rowPtr[h.sendIdx[e]]; k < B.rowPtr[h.sendIdx[e] + 1]; k++, slot++)
+        {
+            sendCols[slot] = B.colIdx[k];
+            sendVals[slot] = B.val[k];
+        }
+    }
+    int *ghostCols = (int *)malloc(ghostPtr[h.ghosts] * sizeof(int) + 1);
+    double *ghostVals = (double *)malloc(ghostPtr[h.ghosts] * sizeof(double) + 1);
+    MPI_Alltoallv(sendCols, sendCounts, sendDispls, MPI_INT, ghostCols, recvCounts, recvDispls,
+                  MPI_INT, MPI_COMM_WORLD);
+    MPI_Alltoallv(sendVals, sendCounts, sendDispls, MPI_DOUBLE, ghostVals, recvCounts, recvDispls,
+                  MPI_DOUBLE, MPI_COMM_WORLD);
+    free(sendLengths);
+    free(sendCols);
+    free(sendVals);
+    free(sendCounts);
+    free(sendDispls);
+    free(recvCounts);
+    free(recvDispls);
+    commTime += MPI_Wtime() - commStart;
+
+    // Gustavson's row-by-row product; the columns of each row of C come out sorted
+    computeStart = MPI_Wtime();
+    Csr C = {.rows = A.rows, .row0 = A.row0, .n = A.n, .cols = B.cols};
+    int capacity = A.nnz + 1024;
+    C.rowPtr = (int *)malloc((A.rows + 1) * sizeof(int));
+    C.colIdx = (int *)malloc(capacity * sizeof(int));
+    C.val = (double *)malloc(capacity * sizeof(double));
+    double *acc = (double *)calloc(B.cols, sizeof(double));
+    int *mark = (int *)malloc(B.cols * sizeof(int));
+    int *touched = (int *)malloc(B.cols * sizeof(int));
+    double flops = 0.0;
+    for (int j = 0; j < B.cols; j++)
+    {
+        mark[j] = -1;
+    }
+    C.rowPtr[0] = 0;
+    for (int i = 0; i < A.rows; i++)
+    {
+        int count = 0;
+        for (int e = A.rowPtr[i]; e < A.rowPtr[i + 1]; e++)
+        {
+            int k = A.colIdx[e];
+            double a = A.val[e];
+            const int *cols = k < h.local ? B.colIdx + B.rowPtr[k] : ghostCols + ghostPtr[k - h.local];
+            const double *vals = k < h.local ? B.val + B.rowPtr[k] : ghostVals + ghostPtr[k - h.local];
+            int length = k < h.local ? B.rowPtr[k + 1] - B.rowPtr[k]
+                                     : ghostPtr[k - h.local + 1] - ghostPtr[k - h.local];
+            for (int q = 0; q < length; q++)
+            {
+                int j = cols[q];
+                if (mark[j] != i)
+                {
+                    mark[j] = i;
+                    acc[j] = 0.0;
+                    touched[count++] = j;
+                }
+                acc[j] += a * vals[q];
+            }
+            flops += 2.0 * length;
+        }
+        if (C.nnz + count > capacity)
+        {
+            capacity = 2 * (C.nnz + count);
+            C.colIdx = (int *)realloc(C.colIdx, capacity * sizeof(int));
+            C.val = (double *)realloc(C.val, capacity * sizeof(double));
+        }
+        qsort(touched, count, sizeof(int), compareInt);
+        for (int q = 0; q < count; q++)
+        {
+            C.colIdx[C.nnz] = touched[q];
+            C.val[C.nnz++] = acc[touched[q]];
+        }
+        C.rowPtr[i + 1] = C.nnz;
+    }
+    computeTime += MPI_Wtime() - computeStart;
+    free(acc);
+    free(mark);
+    free(touched);
+
+    if (io->pathC)
+    {
+        commStart = MPI_Wtime();
+        writeMatrixMarket(io->pathC, &C, rank);
+        commTime += MPI_Wtime() - commStart;
+    }
+
+    double endTime = MPI_Wtime();
+
+    long long counts[2] = {A.nnz, C.nnz}, totals[2];
+    MPI_Reduce(counts, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        printf("SpGEMM: %d x %d times %d x %d, %lld nonzeros in A, %lld in C\n", A.n, A.cols, B.n,
+               B.cols, totals[0], totals[1]);
+    }
+    printSparseTiming(endTime - startTime, computeTime, commTime, flops);
+
+    free(ghostPtr);
+    free(ghostCols);
+    free(ghostVals);
+    haloFree(&h);
+    csrFree(&A);
+    csrFree(&B);
+    csrFree(&C);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size, provided;
+    double startTime;
+
+    // Initialize MPI; only the main thread of each process makes MPI calls
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Print the number of processes
+    if (rank == 0)
+    {
+        printf("Number of processes: %d\n", size);
+    }
+
+    // Start timing
+    startTime = MPI_Wtime();
+
+    // Parse N and the options
+    int N = 0;
+    int naive = 0;
+    int threads = 1;
+    int panelWidth = 256;
+    int cutoff = 256;
+    int iters = 10;
+    int code = 0, wide = 0;
+    const char *mode = "rows";
+    MatrixIo io = {NULL, NULL, NULL, 0};
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-naive") == 0)
+        {
+            naive = 1; // Row mode: use the reference triple loop instead of the blocked kernel
+        }
+        else if (strcmp(argv[i], "-mode") == 0 && i + 1 < argc)
+        {
+            mode = argv[++i];
+        }
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]); // Threads per process for the local multiply
+        }
+        else if (strcmp(argv[i], "-panel") == 0 && i + 1 < argc)
+        {
+            panelWidth = atoi(argv[++i]); // Columns of B per broadcast in the pipeline mode
+        }
+        else if (strcmp(argv[i], "-cutoff") == 0 && i + 1 < argc)
+        {
+            cutoff = atoi(argv[++i]); // Largest block the Strassen mode hands to the blocked kernel
+        }
+        else if (strcmp(argv[i], "-type") == 0 && i + 1 < argc)
+        {
+            // Element type of the dense modes; matrix files carry their own
+            const char *name = argv[++i];
+            for (code = 0; code < 4 && strcmp(name, elementTypes[code].name) != 0; code++)
+            {
+            }
+        }
+        else if (strcmp(argv[i], "-wide") == 0)
+        {
+            wide = 1; // Sum int32 products in int64 and float products in double
+        }
+        else if (strcmp(argv[i], "-iters") == 0 && i + 1 < argc)
+        {
+            iters = atoi(argv[++i]); // Products y = A x timed in the spmv mode
+        }
+        else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc)
+        {
+            io.pathA = argv[++i]; // Read A and B from binary files; N comes from their headers
+        }
+        else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc)
+        {
+            io.pathB = argv[++i];
+        }
+        else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc)
+        {
+            io.pathC = argv[++i]; // Write C to a binary file
+        }
+        else if (strcmp(argv[i], "-print") == 0)
+        {
+            io.print = 1; // Print C as text, only sensible for small N
+        }
+        else
+        {
+            N = atoi(argv[i]);
+        }
+    }
+    // The sparse modes read Matrix Market files instead, and take their size from them
+    int sparse = strcmp(mode, "spmv") == 0 || strcmp(mode, "spgemm") == 0;
+    if (sparse)
+    {
+        N = io.pathA ? 1 : 0;
+    }
+    else if (io.pathA && io.pathB)
+    {
+        int codeB;
+        N = readMatrixSize(io.pathA, &code);
+        if (readMatrixSize(io.pathB, &codeB) != N || codeB != code)
+        {
+            if (rank == 0)
+            {
+                fprintf(stderr, "%s and %s differ in size or type.\n", io.pathA, io.pathB);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    if (N <= 0 || panelWidth <= 0 || cutoff <= 0 || iters <= 0 || code > 3 ||
+        (wide && code % 2 != 0) || (!sparse && !io.pathA != !io.pathB) ||
+        (strcmp(mode, "rows") != 0 && strcmp(mode, "pipeline") != 0 && strcmp(mode, "summa") != 0 &&
+         strcmp(mode, "strassen") != 0 && !sparse))
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr,
+                    "Usage: %s <N> [-naive] [-mode rows|pipeline|summa|strassen] [-threads T] [-panel W] "
+                    "[-cutoff C] [-type int32|int64|float|double] [-wide] [-A file -B file] "
+                    "[-C file] [-print]\n"
+                    "       %s -mode spmv|spgemm -A file.mtx [-B file.mtx] [-C file.mtx] [-iters K] [-print]\n",
+                    argv[0], argv[0]);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // The worker threads make no MPI calls, but the library must still allow threads
+    if (threads > 1 && provided < MPI_THREAD_FUNNELED)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "The MPI library does not support threads; running with -threads 1.\n");
+        }
+        threads = 1;
+    }
+
+    // Run one process per NUMA domain with T threads each: unless the launcher bound
+    // them, the processes on a node take consecutive groups of T CPUs, by their rank
+    // within the node
+    MPI_Comm node;
+    int nodeRank, nodeSize;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &nodeRank);
+    MPI_Comm_size(node, &nodeSize);
+    MPI_Comm_free(&node);
+    poolStart(threads, nodeRank, nodeSize);
+
+    if (strcmp(mode, "spmv") == 0)
+    {
+        multiplySparseVector(&io, iters, rank, size, startTime);
+    }
+    else if (strcmp(mode, "spgemm") == 0)
+    {
+        multiplySparse(&io, rank, size, startTime);
+    }
+    else
+    {
+        // The wide entries follow the plain ones: int32 (0) -> 4, float (2) -> 5
+        const ElementType *type = &elementTypes[wide ? 4 + code / 2 : code];
+        if (rank == 0)
+        {
+            printf("Element type: %s\n", type->name);
+        }
+        if (strcmp(mode, "summa") == 0)
+        {
+            multiplySumma(type, N, &io, rank, size, startTime);
+        }
+        else if (strcmp(mode, "strassen") == 0)
+        {
+            multiplyStrassen(type, N, cutoff, &io, rank, size, startTime);
+        }
+        else
+        {
+            multiplyRows(type, N, naive, strcmp(mode, "pipeline") == 0, panelWidth, &io, rank, size,
+                         startTime);
+        }
     }
-    free(subA);
-    free(subC);
 
+    poolStop();
     MPI_Finalize();
     return 0;
 }
@@ -135,4 +2316,21 @@ int main(int argc, char *argv[])
 // Each process multiplies its part of matrix A with matrix B to compute a part of the result matrix C.
 // Gather Results:
 // Gather the computed parts of matrix C from all processes to the master process.
-// Finalize MPI: Close the MPI environment.
\ No newline at end of file
+// Finalize MPI: Close the MPI environment.
+// With -mode summa, the processes form a square grid instead. Each process builds and keeps only
+// its own tiles of A, B and C, and the tiles of A and B are broadcast along grid rows and columns.
+// With -threads T, each process splits its local multiply over a pool of T pinned threads, so a
+// node can run one process per NUMA domain and share one copy of B between its cores.
+// The row strips may differ by one row, so N need not divide evenly. With -mode pipeline, B is
+// broadcast in column panels of width W (-panel) while the previous panel is being multiplied.
+// With -mode strassen, rank 0 expands the top levels of Strassen-Winograd recursion into products
+// of 7 at a time and deals them out; below the cutoff (-cutoff) the blocked kernel takes over.
+// With -A and -B, the matrices come from binary files (a header, then the elements row by row)
+// and every process reads only its own strip or tile through collective MPI-IO; -C writes C the
+// same way. The text dump of C is off unless -print is given, as it only suits small N.
+// With -mode spmv or spgemm, A (and B) are sparse and come from Matrix Market files. Every
+// process reads a slice of the file, keeps a block of rows in CSR form, and fetches only the
+// remote entries of x, or rows of B, that its rows actually use.
+// With -type, the dense modes work on int32 (the default), int64, float or double elements, and
+// -wide sums int32 and float products in int64 and double. Each pair of types has its own
+// kernels, generated from one set of macros, and C has the type the products are summed in.
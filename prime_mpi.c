@@ -1,11 +1,79 @@
+# include <inttypes.h>
+# include <limits.h>
 # include <math.h>
 # include <mpi.h>
+# include <stdint.h>
 # include <stdio.h>
 # include <stdlib.h>
+# include <string.h>
 # include <time.h>
 
+# if defined ( __AVX2__ ) || defined ( __AVX512VPOPCNTDQ__ )
+# include <immintrin.h>
+# endif
+
+/*
+  SIEVE_SEGMENT is the number of bytes in one sieve segment.  Each byte
+  stands for one odd number, so a segment covers 2*SIEVE_SEGMENT integers
+  and stays resident in a 32 KB L1 data cache.
+*/
+# define SIEVE_SEGMENT 32768
+/*
+  PHI_TINY_C is the number of leading primes whose Legendre function
+  PHI(V,C) is read from a table of one period, PHI_TINY_PRODUCT = 2*3*5*7*11*13,
+  which contains PHI_TINY_TOTIENT integers coprime to it.
+*/
+# define PHI_TINY_C 6
+# define PHI_TINY_PRODUCT 30030
+# define PHI_TINY_TOTIENT 5760
+/*
+  WINDOW_BASE bounds the primes that PRIME_WINDOW sieves with before
+  it runs the Miller-Rabin test on the survivors.
+*/
+# define WINDOW_BASE 65536
+/*
+  WHEEL_SEGMENT is the number of bytes in one segment of PRIME_WHEEL.
+  Each byte holds the 8 residues coprime to 30 of one block of 30
+  integers, so a segment covers 30*WHEEL_SEGMENT integers.
+*/
+# define WHEEL_SEGMENT 32768
+/*
+  PI_TABLE holds PrimePi(V) for 0 <= V <= LIMIT.  Bit K of BITS is set
+  if 2*K+1 is prime, and COUNTS[W] is the number of bits set in words
+  0 through W-1.
+*/
+struct pi_table
+{
+  long long limit;
+  unsigned long long *bits;
+  unsigned int *counts;
+};
+
 int main ( int argc, char *argv[] );
+long long i8_cbrt ( long long n );
+int i4_sqrt ( long long n );
+uint64_t mont_mul ( uint64_t a, uint64_t b, uint64_t n, uint64_t ninv );
+uint64_t popcount_bytes ( const unsigned char *a, int len );
+long long phi_meissel ( long long v, int c, int *primes, struct pi_table *table,
+  unsigned short *tiny );
+void pi_table_build ( struct pi_table *table, long long limit, int id, int p );
+void pi_table_free ( struct pi_table *table );
+long long pi_table_lookup ( struct pi_table *table, long long v );
+long long prime_meissel ( long long x, int id, int p );
 int prime_number ( int n, int id, int p );
+int *prime_base_table ( int n, int *base_num );
+void prime_busy_report ( double busy_part, int id, int p );
+int prime_dynamic ( int n, int id, int chunk, double *busy );
+void prime_list_print ( uint64_t *list, uint64_t list_num, int id, int p );
+int prime_miller_rabin ( uint64_t n );
+uint64_t prime_sieve ( uint64_t n, int id, int p );
+uint64_t prime_sieve_range ( long long lo, long long hi, int id, int p,
+  int *base, int base_num, unsigned char *segment );
+uint64_t prime_sieve_block ( long long lo, long long hi, int *base,
+  int base_num, unsigned char *segment );
+uint64_t prime_wheel ( uint64_t n, int id, int p );
+uint64_t prime_window ( uint64_t a, uint64_t b, int id, int p,
+  uint64_t **list, uint64_t *list_num );
 void timestamp ( );
 
 /******************************************************************************/
@@ -23,6 +91,45 @@ int main ( int argc, char *argv[] )
     This program calls a version of PRIME_NUMBER that includes
     MPI calls for parallel processing.
 
+    The counting engine is chosen on the command line:
+
+      prime_mpi [-engine naive|dynamic|sieve|wheel|meissel|mr]
+        [-n_lo N] [-n_hi N]
+        [-chunk C] [-busy] [-incremental] [-x X] [-window A B [-list]]
+
+    "naive" (the default) is the trial division of PRIME_NUMBER.
+    "dynamic" is the same trial division, but PRIME_DYNAMIC hands out
+    chunks of C consecutive candidates to whichever process asks next.
+    "sieve" is the segmented Sieve of Eratosthenes of PRIME_SIEVE, which
+    gives each process one contiguous block of the range.
+    "wheel" is PRIME_WHEEL, the same segmented sieve, but storing one bit
+    for each integer coprime to 30, and counting with a vector popcount.
+    "meissel" is the combinatorial count of PRIME_MEISSEL, which does
+    not examine every number below N.
+    "mr" is PRIME_WINDOW, a small sieve followed by a deterministic
+    Miller-Rabin test, which works on any window of 64 bit integers.
+
+    N and the counts are 64 bit unsigned integers.  The naive and
+    dynamic engines are limited to N <= INT_MAX.
+
+    With -x X, only the single value X is counted, with the meissel
+    engine; X may be as large as 10^13.
+
+    With -window A B, the sweep is replaced by a count of the primes in
+    [A,B] with the mr engine.  A and B may be as large as 2^64-1.  With
+    -list, the primes themselves are also printed.
+
+    With -busy, each row is followed by the time each process spent
+    in the counting engine, which shows how well the work is balanced.
+    For the dynamic engine this is the time spent testing its own
+    chunks, as the engine ends by waiting for the other processes.
+
+    With -incremental, the sweep is a single pass of the sieve engine:
+    each process keeps its running count and its base prime table from
+    one value of N to the next, and only sieves the new interval
+    (N/N_FACTOR,N].  Each printed time is then the cost of that interval
+    alone.  Asking for any other engine as well is an error.
+
   Licensing:
 
     This code is distributed under the GNU LGPL license. 
@@ -36,20 +143,97 @@ int main ( int argc, char *argv[] )
     John Burkardt
 */
 {
+  int *base;
+  int base_num;
+  int base_root;
+  int busy;
+  double busy_dynamic;
+  double busy_part;
+  int chunk;
+  char *engine;
+  int engine_set;
+  int i;
   int id;
   int ierr;
-  int n;
-  int n_factor;
-  int n_hi;
-  int n_lo;
+  int incremental;
+  int list;
+  uint64_t *list_part;
+  uint64_t list_part_num;
+  uint64_t n;
+  uint64_t n_factor;
+  uint64_t n_hi;
+  uint64_t n_last;
+  uint64_t n_lo;
   int p;
-  int primes;
-  int primes_part;
+  uint64_t primes;
+  uint64_t primes_part;
+  int root;
+  unsigned char *segment;
+  int window;
+  uint64_t window_a;
+  uint64_t window_b;
   double wtime;
 
+  busy = 0;
+  chunk = 256;
+  engine = "naive";
+  engine_set = 0;
+  incremental = 0;
+  list = 0;
+  window = 0;
+  window_a = 0;
+  window_b = 0;
   n_lo = 1;
   n_hi = 262144;
   n_factor = 2;
+
+  for ( i = 1; i < argc; i++ )
+  {
+    if ( strcmp ( argv[i], "-engine" ) == 0 && i + 1 < argc )
+    {
+      engine = argv[++i];
+      engine_set = 1;
+    }
+    else if ( strcmp ( argv[i], "-n_lo" ) == 0 && i + 1 < argc )
+    {
+      n_lo = strtoull ( argv[++i], NULL, 10 );
+    }
+    else if ( strcmp ( argv[i], "-n_hi" ) == 0 && i + 1 < argc )
+    {
+      n_hi = strtoull ( argv[++i], NULL, 10 );
+    }
+    else if ( strcmp ( argv[i], "-chunk" ) == 0 && i + 1 < argc )
+    {
+      chunk = atoi ( argv[++i] );
+    }
+    else if ( strcmp ( argv[i], "-busy" ) == 0 )
+    {
+      busy = 1;
+    }
+    else if ( strcmp ( argv[i], "-incremental" ) == 0 )
+    {
+      incremental = 1;
+    }
+    else if ( strcmp ( argv[i], "-x" ) == 0 && i + 1 < argc )
+    {
+      n_lo = strtoull ( argv[++i], NULL, 10 );
+      n_hi = n_lo;
+      engine = "meissel";
+      engine_set = 1;
+    }
+    else if ( strcmp ( argv[i], "-window" ) == 0 && i + 2 < argc )
+    {
+      window = 1;
+      window_a = strtoull ( argv[++i], NULL, 10 );
+      window_b = strtoull ( argv[++i], NULL, 10 );
+      engine = "mr";
+      engine_set = 1;
+    }
+    else if ( strcmp ( argv[i], "-list" ) == 0 )
+    {
+      list = 1;
+    }
+  }
 /*
   Initialize MPI.
 */
@@ -71,6 +255,52 @@ int main ( int argc, char *argv[] )
 */
   ierr = MPI_Comm_rank ( MPI_COMM_WORLD, &id );
 
+/*
+  The incremental sweep only exists for the sieve engine.
+*/
+  if ( incremental )
+  {
+    if ( engine_set && strcmp ( engine, "sieve" ) != 0 )
+    {
+      if ( id == 0 )
+      {
+        printf ( "\n" );
+        printf ( "PRIME_MPI - Fatal error!\n" );
+        printf ( "  -incremental runs the sieve engine, not \"%s\".\n", engine );
+      }
+      MPI_Finalize ( );
+      exit ( 1 );
+    }
+    engine = "sieve";
+  }
+
+  if ( strcmp ( engine, "naive" ) != 0 && strcmp ( engine, "dynamic" ) != 0 &&
+       strcmp ( engine, "sieve" ) != 0 && strcmp ( engine, "wheel" ) != 0 &&
+       strcmp ( engine, "meissel" ) != 0 && strcmp ( engine, "mr" ) != 0 )
+  {
+    if ( id == 0 )
+    {
+      printf ( "\n" );
+      printf ( "PRIME_MPI - Fatal error!\n" );
+      printf ( "  Unknown engine \"%s\".\n", engine );
+    }
+    MPI_Finalize ( );
+    exit ( 1 );
+  }
+
+  if ( ( strcmp ( engine, "naive" ) == 0 || strcmp ( engine, "dynamic" ) == 0 )
+    && INT_MAX < n_hi )
+  {
+    if ( id == 0 )
+    {
+      printf ( "\n" );
+      printf ( "PRIME_MPI - Fatal error!\n" );
+      printf ( "  The \"%s\" engine needs N_HI <= %d.\n", engine, INT_MAX );
+    }
+    MPI_Finalize ( );
+    exit ( 1 );
+  }
+
   if ( id == 0 )
   {
     timestamp ( );
@@ -80,12 +310,75 @@ int main ( int argc, char *argv[] )
     printf ( "\n" );
     printf ( "  An MPI example program to count the number of primes.\n" );
     printf ( "  The number of processes is %d\n", p );
+    printf ( "  The counting engine is \"%s\"\n", engine );
+    if ( strcmp ( engine, "dynamic" ) == 0 )
+    {
+      printf ( "  Candidates are handed out in chunks of %d.\n", chunk );
+    }
+    if ( incremental )
+    {
+      printf ( "  Each N only sieves the interval above the previous N.\n" );
+    }
     printf ( "\n" );
-    printf ( "         N        Pi          Time\n" );
+    if ( window )
+    {
+      printf ( "                     A                     B"
+        "        Primes          Time\n" );
+    }
+    else
+    {
+      printf ( "         N        Pi          Time\n" );
+    }
     printf ( "\n" );
   }
+/*
+  A window replaces the sweep.
+*/
+  if ( window )
+  {
+    n_lo = 1;
+    n_hi = 0;
+
+    wtime = MPI_Wtime ( );
+
+    list_part = NULL;
+    list_part_num = 0;
+
+    primes_part = prime_window ( window_a, window_b, id, p,
+      list ? &list_part : NULL, &list_part_num );
+
+    ierr = MPI_Reduce ( &primes_part, &primes, 1, MPI_UINT64_T, MPI_SUM, 0,
+      MPI_COMM_WORLD );
+
+    if ( id == 0 )
+    {
+      wtime = MPI_Wtime ( ) - wtime;
+      printf ( "  %20" PRIu64 "  %20" PRIu64 "  %12" PRIu64 "  %12f\n",
+        window_a, window_b, primes, wtime );
+    }
+
+    if ( list )
+    {
+      prime_list_print ( list_part, list_part_num, id, p );
+    }
+    free ( list_part );
+  }
 
   n = n_lo;
+/*
+  The incremental sweep carries its state from one N to the next.
+*/
+  base = NULL;
+  base_num = 0;
+  base_root = 0;
+  n_last = 0;
+  primes_part = 0;
+  segment = NULL;
+
+  if ( incremental )
+  {
+    segment = ( unsigned char * ) malloc ( SIEVE_SEGMENT );
+  }
 
   while ( n <= n_hi )
   {
@@ -93,20 +386,91 @@ int main ( int argc, char *argv[] )
     {
       wtime = MPI_Wtime ( );
     }
-    ierr = MPI_Bcast ( &n, 1, MPI_INT, 0, MPI_COMM_WORLD );
+    ierr = MPI_Bcast ( &n, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD );
 
-    primes_part = prime_number ( n, id, p );
+    busy_part = MPI_Wtime ( );
 
-    ierr = MPI_Reduce ( &primes_part, &primes, 1, MPI_INT, MPI_SUM, 0, 
+    if ( incremental )
+    {
+/*
+  Extend the base primes when sqrt(N) outgrows them.  Doubling the
+  bound means the table is rebuilt only every other step.
+*/
+      root = i4_sqrt ( ( long long ) n );
+      if ( base == NULL || base_root < root )
+      {
+        free ( base );
+        base_root = 2 * root;
+        if ( i4_sqrt ( ( long long ) n_hi ) < base_root )
+        {
+          base_root = i4_sqrt ( ( long long ) n_hi );
+        }
+        base = prime_base_table ( base_root, &base_num );
+      }
+      primes_part = primes_part
+        + prime_sieve_range ( ( long long ) n_last + 1, ( long long ) n, id, p,
+        base, base_num, segment );
+      n_last = n;
+    }
+    else if ( strcmp ( engine, "sieve" ) == 0 )
+    {
+      primes_part = prime_sieve ( n, id, p );
+    }
+    else if ( strcmp ( engine, "wheel" ) == 0 )
+    {
+      primes_part = prime_wheel ( n, id, p );
+    }
+    else if ( strcmp ( engine, "meissel" ) == 0 )
+    {
+/*
+  A share may be negative; the sum in MPI_Reduce is still right modulo 2^64.
+*/
+      primes_part = ( uint64_t ) prime_meissel ( ( long long ) n, id, p );
+    }
+    else if ( strcmp ( engine, "mr" ) == 0 )
+    {
+      primes_part = prime_window ( 1, n, id, p, NULL, NULL );
+    }
+    else if ( strcmp ( engine, "dynamic" ) == 0 )
+    {
+      primes_part = prime_dynamic ( ( int ) n, id, chunk, &busy_dynamic );
+    }
+    else
+    {
+      primes_part = prime_number ( ( int ) n, id, p );
+    }
+
+    busy_part = MPI_Wtime ( ) - busy_part;
+    if ( strcmp ( engine, "dynamic" ) == 0 )
+    {
+      busy_part = busy_dynamic;
+    }
+
+    ierr = MPI_Reduce ( &primes_part, &primes, 1, MPI_UINT64_T, MPI_SUM, 0,
       MPI_COMM_WORLD );
 
     if ( id == 0 )
     {
       wtime = MPI_Wtime ( ) - wtime;
-      printf ( "  %8d  %8d  %14f\n", n, primes, wtime );
+      printf ( "  %8" PRIu64 "  %8" PRIu64 "  %14f\n", n, primes, wtime );
+    }
+
+    if ( busy )
+    {
+      prime_busy_report ( busy_part, id, p );
+    }
+/*
+  Stop before N * N_FACTOR overflows.
+*/
+    if ( n_hi / n_factor < n )
+    {
+      break;
     }
     n = n * n_factor;
   }
+
+  free ( base );
+  free ( segment );
 /*
   Terminate MPI.
 */
@@ -127,6 +491,68 @@ int main ( int argc, char *argv[] )
 }
 /******************************************************************************/
 
+int i4_sqrt ( long long n )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    I4_SQRT returns the integer square root of N.
+
+  Parameters:
+
+    Input, long long N, the number, which must be nonnegative.
+
+    Output, int I4_SQRT, the largest R with R*R <= N.
+*/
+{
+  long long r;
+
+  r = ( long long ) sqrt ( ( double ) n );
+  while ( n < r * r )
+  {
+    r = r - 1;
+  }
+  while ( ( r + 1 ) * ( r + 1 ) <= n )
+  {
+    r = r + 1;
+  }
+
+  return ( int ) r;
+}
+/******************************************************************************/
+
+long long i8_cbrt ( long long n )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    I8_CBRT returns the integer cube root of N.
+
+  Parameters:
+
+    Input, long long N, the number, which must be nonnegative.
+
+    Output, long long I8_CBRT, the largest R with R*R*R <= N.
+*/
+{
+  long long r;
+
+  r = ( long long ) cbrt ( ( double ) n );
+  while ( n < r * r * r )
+  {
+    r = r - 1;
+  }
+  while ( ( r + 1 ) * ( r + 1 ) * ( r + 1 ) <= n )
+  {
+    r = r + 1;
+  }
+
+  return r;
+}
+/******************************************************************************/
+
 int prime_number ( int n, int id, int p )
 
 /******************************************************************************/
@@ -145,18 +571,22 @@ int prime_number ( int n, int id, int p )
     Mathematica can return the number of primes less than or equal to N
     by the command PrimePi[N].
 
-                N  PRIME_NUMBER
+                     N     PRIME_NUMBER
 
-                1           0
-               10           4
-              100          25
-            1,000         168
-           10,000       1,229
-          100,000       9,592
-        1,000,000      78,498
-       10,000,000     664,579
-      100,000,000   5,761,455
-    1,000,000,000  50,847,534
+                     1                0
+                    10                4
+                   100               25
+                 1,000              168
+                10,000            1,229
+               100,000            9,592
+             1,000,000           78,498
+            10,000,000          664,579
+           100,000,000        5,761,455
+         1,000,000,000       50,847,534
+        10,000,000,000      455,052,511
+       100,000,000,000    4,118,054,813
+     1,000,000,000,000   37,607,912,018
+    10,000,000,000,000  346,065,536,839
 
   Licensing:
 
@@ -206,6 +636,1568 @@ int prime_number ( int n, int id, int p )
 }
 /******************************************************************************/
 
+int *prime_base_table ( int n, int *base_num )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_BASE_TABLE returns the odd primes up to N.
+
+  Discussion:
+
+    These are the sieving primes for every segment of PRIME_SIEVE.
+    N is at most the square root of the largest number to be sieved,
+    so a plain byte sieve over [0,N] is small.
+
+  Parameters:
+
+    Input, int N, the largest number to consider.
+
+    Output, int *BASE_NUM, the number of primes returned.
+
+    Output, int *PRIME_BASE_TABLE, the odd primes up to N, in increasing
+    order.  The caller frees this array.
+*/
+{
+  int *base;
+  int i;
+  long long j;
+  unsigned char *mark;
+
+  *base_num = 0;
+
+  if ( n < 3 )
+  {
+    return ( int * ) malloc ( sizeof ( int ) );
+  }
+
+  mark = ( unsigned char * ) calloc ( n + 1, sizeof ( unsigned char ) );
+  base = ( int * ) malloc ( ( n / 2 + 1 ) * sizeof ( int ) );
+
+  for ( i = 3; i <= n; i = i + 2 )
+  {
+    if ( mark[i] )
+    {
+      continue;
+    }
+    base[*base_num] = i;
+    *base_num = *base_num + 1;
+    for ( j = ( long long ) i * i; j <= n; j = j + 2 * i )
+    {
+      mark[j] = 1;
+    }
+  }
+
+  free ( mark );
+
+  return base;
+}
+/******************************************************************************/
+
+uint64_t popcount_bytes ( const unsigned char *a, int len )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    POPCOUNT_BYTES counts the bits set in an array of bytes.
+
+  Discussion:
+
+    With AVX512 VPOPCNTDQ, 64 bytes are counted per instruction.  With
+    AVX2, each nibble is counted by a 16 entry table lookup (VPSHUFB),
+    and the byte counts are summed with VPSADBW, 32 bytes at a time.
+    Otherwise, and for the tail, the scalar popcount is used.
+
+  Parameters:
+
+    Input, const unsigned char A[LEN], the bytes.
+
+    Input, int LEN, the number of bytes.
+
+    Output, uint64_t POPCOUNT_BYTES, the number of bits set.
+*/
+{
+  int i;
+  uint64_t total;
+  uint64_t word;
+
+  i = 0;
+  total = 0;
+
+# if defined ( __AVX512VPOPCNTDQ__ )
+  {
+    __m512i sum;
+
+    sum = _mm512_setzero_si512 ( );
+    for ( ; i + 64 <= len; i = i + 64 )
+    {
+      sum = _mm512_add_epi64 ( sum,
+        _mm512_popcnt_epi64 ( _mm512_loadu_si512 ( a + i ) ) );
+    }
+    total = _mm512_reduce_add_epi64 ( sum );
+  }
+# elif defined ( __AVX2__ )
+  {
+    __m256i counts;
+    __m256i hi;
+    __m256i lo;
+    __m256i low_mask;
+    __m256i lookup;
+    __m256i sum;
+    __m256i v;
+
+    lookup = _mm256_setr_epi8 (
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+    low_mask = _mm256_set1_epi8 ( 0x0f );
+    sum = _mm256_setzero_si256 ( );
+
+    for ( ; i + 32 <= len; i = i + 32 )
+    {
+      v = _mm256_loadu_si256 ( ( const __m256i * ) ( a + i ) );
+      lo = _mm256_and_si256 ( v, low_mask );
+      hi = _mm256_and_si256 ( _mm256_srli_epi16 ( v, 4 ), low_mask );
+      counts = _mm256_add_epi8 ( _mm256_shuffle_epi8 ( lookup, lo ),
+        _mm256_shuffle_epi8 ( lookup, hi ) );
+      sum = _mm256_add_epi64 ( sum,
+        _mm256_sad_epu8 ( counts, _mm256_setzero_si256 ( ) ) );
+    }
+    total = ( uint64_t ) _mm256_extract_epi64 ( sum, 0 )
+      + ( uint64_t ) _mm256_extract_epi64 ( sum, 1 )
+      + ( uint64_t ) _mm256_extract_epi64 ( sum, 2 )
+      + ( uint64_t ) _mm256_extract_epi64 ( sum, 3 );
+  }
+# endif
+
+  for ( ; i + 8 <= len; i = i + 8 )
+  {
+    memcpy ( &word, a + i, 8 );
+    total = total + __builtin_popcountll ( word );
+  }
+  for ( ; i < len; i++ )
+  {
+    total = total + __builtin_popcount ( a[i] );
+  }
+
+  return total;
+}
+/******************************************************************************/
+
+void prime_busy_report ( double busy_part, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_BUSY_REPORT prints the time each process spent counting.
+
+  Discussion:
+
+    The times are gathered on process 0, which prints them, followed by
+    the ratio of the largest to the mean.  A ratio near 1 means the work
+    was evenly balanced.  All processes must call this function.
+
+  Parameters:
+
+    Input, double BUSY_PART, the time this process spent counting.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+*/
+{
+  double *busy;
+  int i;
+  double busy_max;
+  double busy_sum;
+
+  busy = NULL;
+  if ( id == 0 )
+  {
+    busy = ( double * ) malloc ( p * sizeof ( double ) );
+  }
+
+  MPI_Gather ( &busy_part, 1, MPI_DOUBLE, busy, 1, MPI_DOUBLE, 0,
+    MPI_COMM_WORLD );
+
+  if ( id == 0 )
+  {
+    busy_max = 0.0;
+    busy_sum = 0.0;
+    printf ( "            Busy:" );
+    for ( i = 0; i < p; i++ )
+    {
+      if ( 0 < i && i % 4 == 0 )
+      {
+        printf ( "\n                 " );
+      }
+      printf ( "  %12f", busy[i] );
+      if ( busy_max < busy[i] )
+      {
+        busy_max = busy[i];
+      }
+      busy_sum = busy_sum + busy[i];
+    }
+    printf ( "\n" );
+    if ( 0.0 < busy_sum )
+    {
+      printf ( "        Max/mean:  %12f\n", busy_max * p / busy_sum );
+    }
+    free ( busy );
+  }
+
+  return;
+}
+/******************************************************************************/
+
+int prime_dynamic ( int n, int id, int chunk, double *busy )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_DYNAMIC counts primes between 1 and N, balancing the load.
+
+  Discussion:
+
+    The test is the same trial division as PRIME_NUMBER, but the
+    candidates are not dealt out in a fixed pattern.  Instead, a counter
+    in an MPI window on process 0 holds the next unclaimed candidate, and
+    each process claims the next CHUNK candidates with MPI_Fetch_and_op
+    whenever it is ready for more work.  Processes that draw cheap
+    candidates simply come back sooner, so all of them finish at about
+    the same time.  Process 0 counts candidates like the others.
+
+    All processes must call this function.
+
+  Parameters:
+
+    Input, int N, the maximum number to check.
+
+    Input, int ID, the ID of this process.
+
+    Input, int CHUNK, the number of candidates claimed at a time.
+
+    Output, double *BUSY, the time this process spent testing the
+    candidates it claimed, without the setup of the window, the claims
+    and the final wait for the other processes.
+
+    Output, int PRIME_DYNAMIC, the number of primes found by this process.
+*/
+{
+  long long *counter;
+  double busy_start;
+  long long hi;
+  long long i;
+  long long j;
+  int prime;
+  long long start;
+  long long step;
+  int total;
+  MPI_Win win;
+
+  if ( chunk < 1 )
+  {
+    chunk = 1;
+  }
+  step = chunk;
+  total = 0;
+  *busy = 0.0;
+
+  MPI_Win_allocate ( ( id == 0 ) ? sizeof ( long long ) : 0,
+    sizeof ( long long ), MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win );
+
+  MPI_Win_lock_all ( 0, win );
+  if ( id == 0 )
+  {
+    *counter = 2;
+    MPI_Win_sync ( win );
+  }
+  MPI_Barrier ( MPI_COMM_WORLD );
+
+  for ( ; ; )
+  {
+    MPI_Fetch_and_op ( &step, &start, MPI_LONG_LONG, 0, 0, MPI_SUM, win );
+    MPI_Win_flush ( 0, win );
+
+    if ( n < start )
+    {
+      break;
+    }
+
+    hi = start + chunk - 1;
+    if ( n < hi )
+    {
+      hi = n;
+    }
+
+    busy_start = MPI_Wtime ( );
+    for ( i = start; i <= hi; i++ )
+    {
+      prime = 1;
+      for ( j = 2; j < i; j++ )
+      {
+        if ( ( i % j ) == 0 )
+        {
+          prime = 0;
+          break;
+        }
+      }
+      total = total + prime;
+    }
+    *busy = *busy + MPI_Wtime ( ) - busy_start;
+  }
+
+  MPI_Win_unlock_all ( win );
+  MPI_Win_free ( &win );
+
+  return total;
+}
+/******************************************************************************/
+
+void prime_list_print ( uint64_t *list, uint64_t list_num, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_LIST_PRINT prints the primes found by all processes, in order.
+
+  Discussion:
+
+    Each process holds the primes of one contiguous block, so gathering
+    the lists in rank order on process 0 gives them in increasing order.
+    All processes must call this function.
+
+  Parameters:
+
+    Input, uint64_t LIST[LIST_NUM], the primes found by this process.
+
+    Input, uint64_t LIST_NUM, the number of primes found by this process.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+*/
+{
+  uint64_t *all;
+  int all_num;
+  int count;
+  int *counts;
+  int *displs;
+  int i;
+
+  count = ( int ) list_num;
+  counts = NULL;
+  displs = NULL;
+  all = NULL;
+
+  if ( id == 0 )
+  {
+    counts = ( int * ) malloc ( p * sizeof ( int ) );
+    displs = ( int * ) malloc ( p * sizeof ( int ) );
+  }
+
+  MPI_Gather ( &count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD );
+
+  all_num = 0;
+  if ( id == 0 )
+  {
+    for ( i = 0; i < p; i++ )
+    {
+      displs[i] = all_num;
+      all_num = all_num + counts[i];
+    }
+    all = ( uint64_t * ) malloc ( ( all_num + 1 ) * sizeof ( uint64_t ) );
+  }
+
+  MPI_Gatherv ( list, count, MPI_UINT64_T, all, counts, displs, MPI_UINT64_T,
+    0, MPI_COMM_WORLD );
+
+  if ( id == 0 )
+  {
+    printf ( "\n" );
+    for ( i = 0; i < all_num; i++ )
+    {
+      printf ( "  %20" PRIu64 "\n", all[i] );
+    }
+    free ( all );
+    free ( counts );
+    free ( displs );
+  }
+
+  return;
+}
+/******************************************************************************/
+
+int prime_miller_rabin ( uint64_t n )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_MILLER_RABIN determines whether a 64 bit integer is prime.
+
+  Discussion:
+
+    Write N-1 = D*2^S with D odd.  N passes for witness A if A^D = 1,
+    or A^(D*2^R) = N-1 for some R < S, modulo N.  No odd composite below
+    2^64 passes for all of Jim Sinclair's seven witnesses
+
+      2, 325, 9375, 28178, 450775, 9780504, 1795265022,
+
+    so the test is deterministic over the whole range.  The arithmetic
+    is done in Montgomery form, with R = 2^64, by MONT_MUL.
+
+  Parameters:
+
+    Input, uint64_t N, the number to test.
+
+    Output, int PRIME_MILLER_RABIN, is 1 if N is prime, and 0 otherwise.
+*/
+{
+  uint64_t a;
+  uint64_t d;
+  int i;
+  uint64_t minus_one;
+  uint64_t ninv;
+  uint64_t one;
+  int r;
+  uint64_t r2;
+  int s;
+  uint64_t t;
+  static const uint64_t witness[7] = {
+    2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+  uint64_t x;
+
+  if ( n < 2 )
+  {
+    return 0;
+  }
+  if ( n < 4 )
+  {
+    return 1;
+  }
+  if ( n % 2 == 0 )
+  {
+    return 0;
+  }
+
+  d = n - 1;
+  s = 0;
+  while ( d % 2 == 0 )
+  {
+    d = d / 2;
+    s = s + 1;
+  }
+/*
+  NINV = 1/N mod 2^64 by Newton's iteration, which doubles the number
+  of correct bits each time, starting from 3 correct bits.
+*/
+  ninv = n;
+  for ( i = 0; i < 5; i++ )
+  {
+    ninv = ninv * ( 2 - n * ninv );
+  }
+/*
+  ONE = 2^64 mod N and R2 = 2^128 mod N convert into Montgomery form.
+*/
+  one = ( 0 - n ) % n;
+  r2 = ( uint64_t ) ( ( ( unsigned __int128 ) one * one ) % n );
+  minus_one = n - one;
+
+  for ( i = 0; i < 7; i++ )
+  {
+    a = witness[i] % n;
+    if ( a == 0 )
+    {
+      continue;
+    }
+/*
+  X = A^D, by left to right binary powering.
+*/
+    a = mont_mul ( a, r2, n, ninv );
+    x = one;
+    for ( t = ( uint64_t ) 1 << 63; t != 0; t = t >> 1 )
+    {
+      x = mont_mul ( x, x, n, ninv );
+      if ( d & t )
+      {
+        x = mont_mul ( x, a, n, ninv );
+      }
+    }
+
+    if ( x == one || x == minus_one )
+    {
+      continue;
+    }
+
+    for ( r = 1; r < s; r++ )
+    {
+      x = mont_mul ( x, x, n, ninv );
+      if ( x == minus_one )
+      {
+        break;
+      }
+    }
+
+    if ( r == s )
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+/******************************************************************************/
+
+uint64_t prime_sieve ( uint64_t n, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_SIEVE returns the number of primes between 1 and N.
+
+  Discussion:
+
+    This is a segmented Sieve of Eratosthenes.  The range [2,N] is cut
+    into P contiguous blocks, and processor ID sieves block ID, one
+    cache-sized segment at a time.  Every processor builds the same
+    table of base primes up to sqrt(N); it is small enough that
+    recomputing it is cheaper than broadcasting it.
+
+    The sum of the results over all processors is PrimePi(N), as listed
+    in the PRIME_NUMBER table.
+
+    The incremental sweep in MAIN calls PRIME_SIEVE_RANGE directly, so
+    that the base table outlives a single call.
+
+  Parameters:
+
+    Input, uint64_t N, the maximum number to check.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+
+    Output, uint64_t PRIME_SIEVE, the number of primes in the block of
+    processor ID.
+*/
+{
+  int *base;
+  int base_num;
+  unsigned char *segment;
+  uint64_t total;
+
+  if ( n < 2 )
+  {
+    return 0;
+  }
+
+  base = prime_base_table ( i4_sqrt ( ( long long ) n ), &base_num );
+  segment = ( unsigned char * ) malloc ( SIEVE_SEGMENT );
+
+  total = prime_sieve_range ( 2, ( long long ) n, id, p, base, base_num,
+    segment );
+
+  free ( base );
+  free ( segment );
+
+  return total;
+}
+/******************************************************************************/
+
+uint64_t prime_sieve_range ( long long lo, long long hi, int id, int p,
+  int *base, int base_num, unsigned char *segment )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_SIEVE_RANGE counts this processor's share of the primes in [LO,HI].
+
+  Discussion:
+
+    The range is cut into P contiguous blocks, and processor ID sieves
+    block ID.  Summed over all processors, the result is the number of
+    primes in [LO,HI].
+
+  Parameters:
+
+    Input, long long LO, HI, the range to check.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+
+    Input, int BASE[BASE_NUM], the odd primes up to at least sqrt(HI).
+
+    Input, int BASE_NUM, the number of sieving primes.
+
+    Workspace, unsigned char SEGMENT[SIEVE_SEGMENT].
+
+    Output, uint64_t PRIME_SIEVE_RANGE, the number of primes in the block of
+    processor ID.
+*/
+{
+  long long block_hi;
+  long long block_lo;
+  long long width;
+
+  if ( hi < lo )
+  {
+    return 0;
+  }
+
+  width = hi - lo + 1;
+  block_lo = lo + ( width * id ) / p;
+  block_hi = lo + ( width * ( id + 1 ) ) / p - 1;
+
+  if ( block_hi < block_lo )
+  {
+    return 0;
+  }
+
+  return prime_sieve_block ( block_lo, block_hi, base, base_num, segment );
+}
+/******************************************************************************/
+
+uint64_t prime_sieve_block ( long long lo, long long hi, int *base,
+  int base_num, unsigned char *segment )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_SIEVE_BLOCK counts the primes in [LO,HI].
+
+  Discussion:
+
+    Only odd numbers are stored.  The block is processed in segments of
+    SIEVE_SEGMENT odd numbers; for each segment, every base prime Q
+    crosses off its odd multiples, starting no lower than Q*Q.
+
+    BASE must hold every odd prime up to sqrt(HI).
+
+  Parameters:
+
+    Input, long long LO, HI, the range to check.
+
+    Input, int BASE[BASE_NUM], the odd sieving primes.
+
+    Input, int BASE_NUM, the number of sieving primes.
+
+    Workspace, unsigned char SEGMENT[SIEVE_SEGMENT].
+
+    Output, uint64_t PRIME_SIEVE_BLOCK, the number of primes in [LO,HI].
+*/
+{
+  int i;
+  long long j;
+  int k;
+  int len;
+  long long q;
+  long long seg_hi;
+  long long seg_lo;
+  long long start;
+  uint64_t total;
+
+  total = 0;
+
+  if ( lo <= 2 && 2 <= hi )
+  {
+    total = 1;
+  }
+/*
+  SEG_LO is always odd, and SEGMENT[I] stands for SEG_LO + 2*I.
+*/
+  seg_lo = lo;
+  if ( seg_lo < 3 )
+  {
+    seg_lo = 3;
+  }
+  if ( seg_lo % 2 == 0 )
+  {
+    seg_lo = seg_lo + 1;
+  }
+
+  while ( seg_lo <= hi )
+  {
+    seg_hi = seg_lo + 2 * ( long long ) ( SIEVE_SEGMENT - 1 );
+    if ( hi < seg_hi )
+    {
+      seg_hi = hi;
+    }
+    len = ( int ) ( ( seg_hi - seg_lo ) / 2 ) + 1;
+
+    memset ( segment, 1, len );
+
+    for ( k = 0; k < base_num; k++ )
+    {
+      q = base[k];
+      if ( seg_hi < q * q )
+      {
+        break;
+      }
+/*
+  The first odd multiple of Q in the segment, but not below Q*Q.
+*/
+      start = ( ( seg_lo + q - 1 ) / q ) * q;
+      if ( start < q * q )
+      {
+        start = q * q;
+      }
+      if ( start % 2 == 0 )
+      {
+        start = start + q;
+      }
+      for ( j = ( start - seg_lo ) / 2; j < len; j = j + q )
+      {
+        segment[j] = 0;
+      }
+    }
+
+    for ( i = 0; i < len; i++ )
+    {
+      total = total + segment[i];
+    }
+
+    seg_lo = seg_hi + 2;
+  }
+
+  return total;
+}
+/******************************************************************************/
+
+uint64_t mont_mul ( uint64_t a, uint64_t b, uint64_t n, uint64_t ninv )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    MONT_MUL returns the Montgomery product A*B/2^64 mod N.
+
+  Discussion:
+
+    With T = A*B and M = T*NINV mod 2^64, T - M*N is divisible by 2^64,
+    and its high word is the product.  Computing it as a difference of
+    high words avoids the overflow of T + M*N when N is close to 2^64.
+
+  Parameters:
+
+    Input, uint64_t A, B, the factors, in [0,N).
+
+    Input, uint64_t N, the odd modulus.
+
+    Input, uint64_t NINV, the inverse of N modulo 2^64.
+
+    Output, uint64_t MONT_MUL, the Montgomery product, in [0,N).
+*/
+{
+  uint64_t m;
+  uint64_t t_hi;
+  uint64_t u_hi;
+  unsigned __int128 t;
+
+  t = ( unsigned __int128 ) a * b;
+  m = ( uint64_t ) t * ninv;
+  t_hi = ( uint64_t ) ( t >> 64 );
+  u_hi = ( uint64_t ) ( ( ( unsigned __int128 ) m * n ) >> 64 );
+
+  if ( t_hi < u_hi )
+  {
+    return t_hi - u_hi + n;
+  }
+  return t_hi - u_hi;
+}
+/******************************************************************************/
+
+long long phi_meissel ( long long v, int c, int *primes, struct pi_table *table,
+  unsigned short *tiny )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PHI_MEISSEL returns Legendre's function PHI(V,C).
+
+  Discussion:
+
+    PHI(V,C) is the number of integers in [1,V] that are not divisible
+    by any of the first C primes.  It satisfies
+
+      PHI(V,C) = PHI(V,C-1) - PHI(V/P(C),C-1),
+
+    which is unrolled here down to C = PHI_TINY_C, where a table of one
+    period gives the answer directly.  The recursion is cut short when
+    V < P(C+1)^2, because then the survivors are 1 and the primes in
+    (P(C),V], and PHI(V,C) = PrimePi(V) - C + 1.
+
+  Parameters:
+
+    Input, long long V, the upper limit.
+
+    Input, int C, the number of primes to exclude, at least PHI_TINY_C.
+
+    Input, int PRIMES[], the primes in increasing order, starting with 2,
+    at least up to P(C+1).
+
+    Input, struct pi_table *TABLE, PrimePi up to at least P(C+1)^2.
+
+    Input, unsigned short TINY[PHI_TINY_PRODUCT], PHI(R,PHI_TINY_C)
+    for 0 <= R < PHI_TINY_PRODUCT.
+
+    Output, long long PHI_MEISSEL, the value of PHI(V,C).
+*/
+{
+  int i;
+  long long pi_v;
+  long long total;
+  long long u;
+
+  if ( c <= PHI_TINY_C )
+  {
+    return ( v / PHI_TINY_PRODUCT ) * PHI_TINY_TOTIENT
+      + tiny[v % PHI_TINY_PRODUCT];
+  }
+
+  if ( v < ( long long ) primes[c] * primes[c] )
+  {
+    pi_v = pi_table_lookup ( table, v );
+    if ( pi_v <= c )
+    {
+      return ( 0 < v );
+    }
+    return pi_v - c + 1;
+  }
+
+  total = ( v / PHI_TINY_PRODUCT ) * PHI_TINY_TOTIENT
+    + tiny[v % PHI_TINY_PRODUCT];
+
+  for ( i = PHI_TINY_C + 1; i <= c; i++ )
+  {
+    u = v / primes[i-1];
+/*
+  Once V/P(I) < P(I), each remaining term PHI(V/P(J),J-1) is 1,
+  for every J with P(J) <= V.
+*/
+    if ( u < primes[i-1] )
+    {
+      if ( v < primes[c-1] )
+      {
+        total = total - ( pi_table_lookup ( table, v ) - i + 1 );
+      }
+      else
+      {
+        total = total - ( c - i + 1 );
+      }
+      break;
+    }
+    total = total - phi_meissel ( u, i - 1, primes, table, tiny );
+  }
+
+  return total;
+}
+/******************************************************************************/
+
+void pi_table_build ( struct pi_table *table, long long limit, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PI_TABLE_BUILD builds a table of PrimePi up to LIMIT.
+
+  Discussion:
+
+    The table stores one bit per odd number.  Its words are cut into P
+    contiguous blocks; processor ID sieves block ID, one cache-sized
+    segment at a time, and MPI_Allgatherv then gives every processor
+    the whole table.  All processors must call this function.
+
+  Parameters:
+
+    Output, struct pi_table *TABLE, the table.
+
+    Input, long long LIMIT, the largest argument that will be looked up.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+*/
+{
+  int *base;
+  int base_num;
+  int *block_num;
+  int *block_start;
+  unsigned long long *bits;
+  long long j;
+  int k;
+  long long q;
+  long long seg_hi;
+  long long seg_lo;
+  long long start;
+  int w;
+  int w_hi;
+  int w_lo;
+  int w_num;
+  int w_seg;
+
+  table->limit = limit;
+  w_num = ( int ) ( limit / 128 ) + 1;
+
+  bits = ( unsigned long long * ) malloc ( w_num * sizeof ( unsigned long long ) );
+  block_num = ( int * ) malloc ( p * sizeof ( int ) );
+  block_start = ( int * ) malloc ( p * sizeof ( int ) );
+
+  for ( k = 0; k < p; k++ )
+  {
+    block_start[k] = ( int ) ( ( ( long long ) w_num * k ) / p );
+    block_num[k] = ( int ) ( ( ( long long ) w_num * ( k + 1 ) ) / p )
+      - block_start[k];
+  }
+
+  base = prime_base_table ( i4_sqrt ( 128 * ( long long ) w_num ), &base_num );
+/*
+  Word W holds the odd numbers 128*W+1 through 128*W+127.
+*/
+  w_lo = block_start[id];
+  w_hi = w_lo + block_num[id];
+  w_seg = SIEVE_SEGMENT / sizeof ( unsigned long long );
+
+  for ( w = w_lo; w < w_hi; w = w + w_seg )
+  {
+    seg_lo = 128 * ( long long ) w + 1;
+    seg_hi = 128 * ( long long ) ( w + w_seg ) - 1;
+    if ( 128 * ( long long ) w_hi - 1 < seg_hi )
+    {
+      seg_hi = 128 * ( long long ) w_hi - 1;
+    }
+
+    memset ( bits + w, 0xff, ( ( seg_hi + 1 ) / 128 - w )
+      * sizeof ( unsigned long long ) );
+
+    for ( k = 0; k < base_num; k++ )
+    {
+      q = base[k];
+      if ( seg_hi < q * q )
+      {
+        break;
+      }
+      start = ( ( seg_lo + q - 1 ) / q ) * q;
+      if ( start < q * q )
+      {
+        start = q * q;
+      }
+      if ( start % 2 == 0 )
+      {
+        start = start + q;
+      }
+      for ( j = ( start - 1 ) / 2; j <= ( seg_hi - 1 ) / 2; j = j + q )
+      {
+        bits[j/64] = bits[j/64] & ~( 1ULL << ( j % 64 ) );
+      }
+    }
+  }
+/*
+  1 is not prime.
+*/
+  if ( w_lo == 0 && 0 < w_hi )
+  {
+    bits[0] = bits[0] & ~1ULL;
+  }
+
+  MPI_Allgatherv ( MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bits, block_num,
+    block_start, MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD );
+
+  table->bits = bits;
+  table->counts = ( unsigned int * ) malloc ( w_num * sizeof ( unsigned int ) );
+  table->counts[0] = 0;
+  for ( w = 1; w < w_num; w++ )
+  {
+    table->counts[w] = table->counts[w-1] + __builtin_popcountll ( bits[w-1] );
+  }
+
+  free ( base );
+  free ( block_num );
+  free ( block_start );
+
+  return;
+}
+/******************************************************************************/
+
+void pi_table_free ( struct pi_table *table )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PI_TABLE_FREE frees the memory of a PrimePi table.
+
+  Parameters:
+
+    Input/output, struct pi_table *TABLE, the table.
+*/
+{
+  free ( table->bits );
+  free ( table->counts );
+  table->bits = NULL;
+  table->counts = NULL;
+  table->limit = 0;
+
+  return;
+}
+/******************************************************************************/
+
+long long pi_table_lookup ( struct pi_table *table, long long v )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PI_TABLE_LOOKUP returns PrimePi(V) from a table.
+
+  Parameters:
+
+    Input, struct pi_table *TABLE, the table.
+
+    Input, long long V, the argument, at most TABLE->LIMIT.
+
+    Output, long long PI_TABLE_LOOKUP, the number of primes up to V.
+*/
+{
+  int bit;
+  long long k;
+  unsigned long long mask;
+  long long w;
+
+  if ( v < 2 )
+  {
+    return 0;
+  }
+/*
+  K indexes the largest odd number not above V.
+*/
+  k = ( v - 1 ) / 2;
+  w = k / 64;
+  bit = ( int ) ( k % 64 );
+
+  if ( bit == 63 )
+  {
+    mask = ~0ULL;
+  }
+  else
+  {
+    mask = ( 2ULL << bit ) - 1;
+  }
+
+  return 1 + table->counts[w] + __builtin_popcountll ( table->bits[w] & mask );
+}
+/******************************************************************************/
+
+long long prime_meissel ( long long x, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_MEISSEL returns this processor's share of PrimePi(X).
+
+  Discussion:
+
+    With Y = X^(1/3), A = PrimePi(Y) and B = PrimePi(X^(1/2)),
+    Meissel's formula is
+
+      PrimePi(X) = PHI(X,A) + A - 1 - P2(X,A),
+
+      P2(X,A) = sum ( A < I <= B ) ( PrimePi(X/P(I)) - I + 1 ),
+
+    where P2 counts the integers up to X with exactly two prime factors,
+    both above Y.  Every argument of PrimePi that occurs is at most X/Y,
+    which is about X^(2/3), so the work is dominated by sieving that far
+    rather than to X.
+
+    The PrimePi table up to X/Y is sieved in parallel by PI_TABLE_BUILD.
+    The leaves of PHI(X,A) = PHI(X,PHI_TINY_C) - sum PHI(X/P(I),I-1),
+    and the terms of P2, are dealt out to the processors in turn.
+    Summing the results over all processors, as MPI_Reduce does in MAIN,
+    gives PrimePi(X).  The share of a processor may be negative.
+
+    All processors must call this function.
+
+  Parameters:
+
+    Input, long long X, the maximum number to check.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+
+    Output, long long PRIME_MEISSEL, the share of processor ID.
+*/
+{
+  int a;
+  int b;
+  int i;
+  long long k;
+  long long limit;
+  int *primes;
+  int primes_num;
+  long long r;
+  long long root;
+  struct pi_table table;
+  unsigned short *tiny;
+  long long total;
+  long long y;
+
+  if ( x < 2 )
+  {
+    return 0;
+  }
+
+  y = i8_cbrt ( x );
+  root = i4_sqrt ( x );
+/*
+  Below 17^3, A would not exceed PHI_TINY_C, and the table may as well
+  cover X itself.
+*/
+  if ( y < 17 )
+  {
+    pi_table_build ( &table, x, id, p );
+    total = 0;
+    if ( id == 0 )
+    {
+      total = pi_table_lookup ( &table, x );
+    }
+    pi_table_free ( &table );
+    return total;
+  }
+
+  limit = x / y;
+  pi_table_build ( &table, limit, id, p );
+
+  a = ( int ) pi_table_lookup ( &table, y );
+  b = ( int ) pi_table_lookup ( &table, root );
+/*
+  PRIMES holds P(1) through P(B+1), taken from the table.
+*/
+  primes = ( int * ) malloc ( ( b + 1 ) * sizeof ( int ) );
+  primes[0] = 2;
+  primes_num = 1;
+  for ( k = 3; primes_num <= b; k = k + 2 )
+  {
+    if ( ( table.bits[k/128] >> ( ( k / 2 ) % 64 ) ) & 1 )
+    {
+      primes[primes_num] = ( int ) k;
+      primes_num = primes_num + 1;
+    }
+  }
+
+  tiny = ( unsigned short * ) malloc ( PHI_TINY_PRODUCT
+    * sizeof ( unsigned short ) );
+  tiny[0] = 0;
+  for ( r = 1; r < PHI_TINY_PRODUCT; r++ )
+  {
+    tiny[r] = tiny[r-1];
+    for ( i = 0; i < PHI_TINY_C; i++ )
+    {
+      if ( r % primes[i] == 0 )
+      {
+        break;
+      }
+    }
+    if ( i == PHI_TINY_C )
+    {
+      tiny[r] = tiny[r] + 1;
+    }
+  }
+
+  total = 0;
+
+  if ( id == 0 )
+  {
+    total = ( x / PHI_TINY_PRODUCT ) * PHI_TINY_TOTIENT
+      + tiny[x % PHI_TINY_PRODUCT] + a - 1;
+  }
+
+  for ( i = PHI_TINY_C + 1; i <= a; i++ )
+  {
+    if ( i % p == id )
+    {
+      total = total - phi_meissel ( x / primes[i-1], i - 1, primes, &table,
+        tiny );
+    }
+  }
+
+  for ( i = a + 1; i <= b; i++ )
+  {
+    if ( i % p == id )
+    {
+      total = total - ( pi_table_lookup ( &table, x / primes[i-1] ) - i + 1 );
+    }
+  }
+
+  free ( primes );
+  free ( tiny );
+  pi_table_free ( &table );
+
+  return total;
+}
+/******************************************************************************/
+
+uint64_t prime_wheel ( uint64_t n, int id, int p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_WHEEL returns the number of primes between 1 and N.
+
+  Discussion:
+
+    This is the segmented sieve of PRIME_SIEVE on a mod 30 wheel.  Byte
+    K of the sieve stands for the block 30*K through 30*K+29, and its
+    bits for the 8 residues 1, 7, 11, 13, 17, 19, 23, 29 that are
+    coprime to 30.  That is 3.75 integers per bit, against 2 integers per
+    byte in PRIME_SIEVE, so the sieve is 15 times smaller, and a segment
+    of WHEEL_SEGMENT bytes spans 30*WHEEL_SEGMENT integers.
+
+    The bytes [0,N/30] are cut into P contiguous blocks, and processor ID
+    sieves block ID.  A base prime Q >= 7 crosses off Q*M for M >= Q
+    coprime to 30.  For each of the 8 residues R of M, the multiples
+    Q*(30*K+R) all fall on the same bit, one every Q bytes, so each
+    residue is a simple strided loop.  The survivors are counted with
+    POPCOUNT_BYTES.  2, 3 and 5 are counted separately by processor 0.
+
+  Parameters:
+
+    Input, uint64_t N, the maximum number to check.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+
+    Output, uint64_t PRIME_WHEEL, the number of primes in the block of
+    processor ID.
+*/
+{
+  int *base;
+  int base_num;
+  static const int bit_of[30] = {
+    -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1,
+    -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7 };
+  long long block_hi;
+  long long block_lo;
+  int b;
+  long long byte;
+  long long bytes;
+  long long k0;
+  int k;
+  int len;
+  long long m_min;
+  unsigned char mask;
+  long long q;
+  int r;
+  static const int residue[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+  unsigned char *segment;
+  long long seg_hi;
+  long long seg_lo;
+  uint64_t total;
+
+  total = 0;
+
+  if ( id == 0 )
+  {
+    total = ( 2 <= n ) + ( 3 <= n ) + ( 5 <= n );
+  }
+
+  if ( n < 7 )
+  {
+    return total;
+  }
+
+  bytes = ( long long ) ( n / 30 ) + 1;
+  block_lo = ( bytes * id ) / p;
+  block_hi = ( bytes * ( id + 1 ) ) / p;
+
+  if ( block_hi <= block_lo )
+  {
+    return total;
+  }
+
+  base = prime_base_table ( i4_sqrt ( ( long long ) n ), &base_num );
+  segment = ( unsigned char * ) malloc ( WHEEL_SEGMENT );
+
+  for ( seg_lo = block_lo; seg_lo < block_hi; seg_lo = seg_hi )
+  {
+    seg_hi = seg_lo + WHEEL_SEGMENT;
+    if ( block_hi < seg_hi )
+    {
+      seg_hi = block_hi;
+    }
+    len = ( int ) ( seg_hi - seg_lo );
+
+    memset ( segment, 0xff, len );
+/*
+  1 is not prime.
+*/
+    if ( seg_lo == 0 )
+    {
+      segment[0] = segment[0] & 0xfe;
+    }
+
+    for ( k = 0; k < base_num; k++ )
+    {
+      q = base[k];
+      if ( q < 7 )
+      {
+        continue;
+      }
+      if ( 30 * seg_hi <= q * q )
+      {
+        break;
+      }
+/*
+  M_MIN is the smallest cofactor whose multiple can lie in this segment.
+*/
+      m_min = ( 30 * seg_lo + q - 1 ) / q;
+      if ( m_min < q )
+      {
+        m_min = q;
+      }
+      for ( r = 0; r < 8; r++ )
+      {
+        k0 = 0;
+        if ( residue[r] < m_min )
+        {
+          k0 = ( m_min - residue[r] + 29 ) / 30;
+        }
+        byte = ( q * ( 30 * k0 + residue[r] ) ) / 30 - seg_lo;
+        b = bit_of[( q * residue[r] ) % 30];
+        mask = ( unsigned char ) ~( 1 << b );
+        for ( ; byte < len; byte = byte + q )
+        {
+          segment[byte] = segment[byte] & mask;
+        }
+      }
+    }
+/*
+  Drop the residues above N in the last byte.
+*/
+    if ( seg_hi == bytes )
+    {
+      for ( r = 0; r < 8; r++ )
+      {
+        if ( n < ( uint64_t ) ( 30 * ( bytes - 1 ) + residue[r] ) )
+        {
+          segment[len-1] = segment[len-1] & ( unsigned char ) ~( 1 << r );
+        }
+      }
+    }
+
+    total = total + popcount_bytes ( segment, len );
+  }
+
+  free ( base );
+  free ( segment );
+
+  return total;
+}
+/******************************************************************************/
+
+uint64_t prime_window ( uint64_t a, uint64_t b, int id, int p,
+  uint64_t **list, uint64_t *list_num )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PRIME_WINDOW counts this processor's share of the primes in [A,B].
+
+  Discussion:
+
+    The window is cut into P contiguous blocks, and processor ID takes
+    block ID.  Its odd numbers are sieved one segment at a time by the
+    odd primes up to WINDOW_BASE, and each survivor above WINDOW_BASE^2
+    is confirmed by PRIME_MILLER_RABIN.  Nothing is sieved from 2, so
+    the cost depends only on the width of the window, and A and B may
+    lie anywhere below 2^64.
+
+  Parameters:
+
+    Input, uint64_t A, B, the window.
+
+    Input, int ID, the ID of this process,
+    between 0 and P-1.
+
+    Input, int P, the number of processes.
+
+    Output, uint64_t **LIST, if not NULL, a newly allocated array of
+    the primes found, in increasing order.
+
+    Output, uint64_t *LIST_NUM, if LIST is not NULL, the number of
+    primes in *LIST.
+
+    Output, uint64_t PRIME_WINDOW, the number of primes in the block of
+    processor ID.
+*/
+{
+  int *base;
+  int base_num;
+  uint64_t block_hi;
+  uint64_t block_lo;
+  int i;
+  uint64_t j;
+  int k;
+  uint64_t len;
+  uint64_t list_max;
+  uint64_t off;
+  uint64_t q;
+  uint64_t seg_lo;
+  unsigned char *segment;
+  uint64_t total;
+  uint64_t v;
+  unsigned __int128 width;
+
+  total = 0;
+  if ( list != NULL )
+  {
+    *list = NULL;
+    *list_num = 0;
+  }
+  list_max = 0;
+
+  if ( b < a )
+  {
+    return 0;
+  }
+
+  width = ( unsigned __int128 ) b - a + 1;
+  block_lo = a + ( uint64_t ) ( ( width * id ) / p );
+  if ( ( width * ( id + 1 ) ) / p == ( width * id ) / p )
+  {
+    return 0;
+  }
+  block_hi = a + ( uint64_t ) ( ( width * ( id + 1 ) ) / p - 1 );
+
+  if ( block_lo <= 2 && 2 <= block_hi )
+  {
+    total = 1;
+    if ( list != NULL )
+    {
+      list_max = 1024;
+      *list = ( uint64_t * ) malloc ( list_max * sizeof ( uint64_t ) );
+      ( *list )[0] = 2;
+      *list_num = 1;
+    }
+  }
+
+  seg_lo = block_lo;
+  if ( seg_lo < 3 )
+  {
+    seg_lo = 3;
+  }
+  if ( seg_lo % 2 == 0 )
+  {
+    if ( seg_lo == UINT64_MAX )
+    {
+      return total;
+    }
+    seg_lo = seg_lo + 1;
+  }
+  if ( block_hi < seg_lo )
+  {
+    return total;
+  }
+
+  base = prime_base_table ( WINDOW_BASE, &base_num );
+  segment = ( unsigned char * ) malloc ( SIEVE_SEGMENT );
+/*
+  SEG_LO is odd, and SEGMENT[I] stands for SEG_LO + 2*I.  Offsets are
+  used throughout so that nothing overflows near 2^64.
+*/
+  for ( ; ; )
+  {
+    len = ( block_hi - seg_lo ) / 2 + 1;
+    if ( SIEVE_SEGMENT < len )
+    {
+      len = SIEVE_SEGMENT;
+    }
+
+    memset ( segment, 1, len );
+
+    for ( k = 0; k < base_num; k++ )
+    {
+      q = base[k];
+/*
+  OFF is the offset from SEG_LO of the first odd multiple of Q.
+*/
+      off = ( q - seg_lo % q ) % q;
+      if ( off % 2 == 1 )
+      {
+        off = off + q;
+      }
+      j = off / 2;
+      if ( seg_lo + off == q )
+      {
+        j = j + q;
+      }
+      for ( ; j < len; j = j + q )
+      {
+        segment[j] = 0;
+      }
+    }
+
+    for ( i = 0; i < ( int ) len; i++ )
+    {
+      if ( !segment[i] )
+      {
+        continue;
+      }
+      v = seg_lo + 2 * ( uint64_t ) i;
+      if ( ( uint64_t ) WINDOW_BASE * WINDOW_BASE < v &&
+           !prime_miller_rabin ( v ) )
+      {
+        continue;
+      }
+      total = total + 1;
+      if ( list != NULL )
+      {
+        if ( *list_num == list_max )
+        {
+          list_max = 2 * list_max + 1024;
+          *list = ( uint64_t * ) realloc ( *list,
+            list_max * sizeof ( uint64_t ) );
+        }
+        ( *list )[*list_num] = v;
+        *list_num = *list_num + 1;
+      }
+    }
+
+    if ( ( block_hi - seg_lo ) / 2 + 1 <= SIEVE_SEGMENT )
+    {
+      break;
+    }
+    seg_lo = seg_lo + 2 * ( uint64_t ) SIEVE_SEGMENT;
+  }
+
+  free ( base );
+  free ( segment );
+
+  return total;
+}
+/******************************************************************************/
+
 void timestamp ( )
 
 /******************************************************************************/
@@ -1,15 +1,72 @@
 #include <mpi.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define CHUNK 65536 // Elements a process holds at a time in streaming mode
+#define BINS 16     // Bins of the histogram
+
+// Values the statistics pass takes at a time: as many as the widest vector registers of the
+// target hold, since wider GCC vectors are split into pieces of that width and lose to them
+#if defined(__AVX512F__)
+#define LANES 8
+#elif defined(__AVX2__)
+#define LANES 4
+#else
+#define LANES 2
+#endif
+
+#if defined(__GNUC__)
+typedef double Lanes __attribute__((vector_size(LANES * sizeof(double))));
+typedef long long LaneMasks __attribute__((vector_size(LANES * sizeof(long long))));
+
+// Select the lanes of a where mask is set and of b elsewhere, as C has no vector ?:
+#define BLEND(mask, a, b) ((Lanes)(((LaneMasks)(a) & (mask)) | ((LaneMasks)(b) & ~(mask))))
+#endif
+
+// Exact sum of many 64-bit values: a 128-bit two's complement number as four 32-bit limbs,
+// least significant first. Each limb is kept in a 64-bit word, so the limbs of the partial
+// sums of up to 2^32 processes can be added with MPI_SUM and the carries propagated after.
+typedef struct
+{
+    uint64_t limbs[4];
+} WideSum;
+
+// Statistics of a set of values, which merge into those of the union of two sets. The moments
+// are Welford's: the mean and the sum of squared deviations from it. The sum carries the
+// rounding error of its additions, which is added in at the end.
+typedef struct
+{
+    long long count;
+    double mean, m2;
+    double sum, compensation;
+    double min, max;
+    long long histogram[BINS]; // Counts of BINS equal bins over the range; values outside go to the end bins
+} Stats;
+
+long long rangeStart(long long n, int parts, int p);
+void addToSum(WideSum *sum, long long value);
+void carrySum(WideSum *sum);
+void formatSum(const WideSum *sum, char *text);
+void accumulateStats(Stats *stats, const double *values, int n, double low, double high);
+void mergeStats(Stats *into, const Stats *from);
+void mergeStatsOp(void *in, void *inout, int *len, MPI_Datatype *type);
+void reduceStats(const Stats *local, Stats *total);
+void printStats(const Stats *stats, double low, double high);
 
 int main(int argc, char *argv[])
 {
     int rank, size, i;
-    long long int N; // Total number of elements
+    long long int N = -1; // Total number of elements
     int elements_per_proc;
     int *data = NULL, *sub_data;
     long long int local_sum = 0, total_sum = 0; // Use long long int for sums
     double startTime, endTime;
+    int stream = 0;          // Each process produces or reads its own range, CHUNK elements at a time
+    const char *path = NULL; // File of native 32-bit ints to sum in streaming mode
+    double low = 0.0, high = 0.0; // Range of the histogram, set from the data unless given
+    Stats localStats = {0}, totalStats;
 
     MPI_Init(&argc, &argv);               // Initialize MPI
     MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get current process rank
@@ -23,12 +80,50 @@ int main(int argc, char *argv[])
     // Start timing
     startTime = MPI_Wtime();
 
-    // Accept N from command line argument if provided, else use a default value
-    if (argc > 1)
+    // Accept N and the options from the command line
+    for (i = 1; i < argc; i++)
     {
-        N = atoll(argv[1]); // Use atoll for converting string to long long int
+        if (strcmp(argv[i], "-stream") == 0)
+        {
+            stream = 1;
+        }
+        else if (strcmp(argv[i], "-file") == 0 && i + 1 < argc)
+        {
+            stream = 1;
+            path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-histogram") == 0 && i + 2 < argc)
+        {
+            low = atof(argv[++i]);
+            high = atof(argv[++i]);
+        }
+        else
+        {
+            N = atoll(argv[i]); // Use atoll for converting string to long long int
+        }
+    }
+
+    // A file holds the elements, N of them at most; without one, the elements are 1 to N
+    MPI_File fh = MPI_FILE_NULL;
+    if (path != NULL)
+    {
+        MPI_Offset fileSize;
+        if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+        {
+            if (rank == 0)
+            {
+                printf("Cannot open %s\n", path);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        MPI_File_get_size(fh, &fileSize);
+        if (N < 0 || N > fileSize / (MPI_Offset)sizeof(int))
+        {
+            N = fileSize / (MPI_Offset)sizeof(int);
+        }
     }
-    else
+    else if (N < 0)
     {
         if (rank == 0)
         { // Only the master process should handle the default or prompt for input
@@ -36,8 +131,107 @@ int main(int argc, char *argv[])
         }
         N = 1000; // Default value
     }
+    if (low >= high)
+    {
+        low = path != NULL ? INT32_MIN : 1.0;
+        high = path != NULL ? INT32_MAX + 1.0 : N + 1.0;
+    }
+
+    if (stream)
+    {
+        // Every process sums its own range of elements, the first N % size of which have one
+        // more element, CHUNK elements at a time. The chunk sums fit in 64 bits; the sum of
+        // the range is kept wider. The statistics of each chunk are taken while it is still
+        // in the cache.
+        long long first = rangeStart(N, size, rank);
+        long long count = rangeStart(N, size, rank + 1) - first;
+        long long chunks = (rangeStart(N, size, 1) + CHUNK - 1) / CHUNK; // The same on all processes
+        if (path == NULL && N > INT64_MAX / CHUNK)
+        {
+            if (rank == 0)
+            {
+                printf("N is too large for the chunk sums.\n");
+            }
+            MPI_Finalize();
+            return 1;
+        }
+
+        double *values = (double *)malloc(CHUNK * sizeof(double));
+        int *fileValues = (int *)malloc(CHUNK * sizeof(int));
+        WideSum localSum = {{0}}, totalSum = {{0}};
+        for (long long c = 0; c < chunks; c++)
+        {
+            long long start = first + c * CHUNK;
+            long long left = count - c * CHUNK;
+            int n = left <= 0 ? 0 : left < CHUNK ? (int)left : CHUNK;
+            long long chunkSum = 0;
+            if (path != NULL)
+            {
+                // Collective, so processes with no chunk left still take part
+                MPI_File_read_at_all(fh, (MPI_Offset)start * sizeof(int), fileValues, n, MPI_INT, MPI_STATUS_IGNORE);
+                for (i = 0; i < n; i++)
+                {
+                    values[i] = fileValues[i];
+                    chunkSum += fileValues[i];
+                }
+            }
+            else
+            {
+                for (i = 0; i < n; i++)
+                {
+                    values[i] = (double)(start + i + 1); // The numbers 1 to N, as in the scattered mode
+                    chunkSum += start + i + 1;
+                }
+            }
+            addToSum(&localSum, chunkSum);
+            accumulateStats(&localStats, values, n, low, high);
+        }
+
+        // The limbs of the partial sums add up without overflow and are carried on the master
+        MPI_Reduce(localSum.limbs, totalSum.limbs, 4, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        reduceStats(&localStats, &totalStats);
+
+        endTime = MPI_Wtime();
+
+        if (rank == 0)
+        {
+            char text[48];
+            carrySum(&totalSum);
+            formatSum(&totalSum, text);
+            printf("Total sum = %s\n", text);
+            printStats(&totalStats, low, high);
+            printf("Execution time: %f seconds\n", endTime - startTime);
+        }
+
+        if (fh != MPI_FILE_NULL)
+        {
+            MPI_File_close(&fh);
+        }
+        free(values);
+        free(fileValues);
+        MPI_Finalize();
+        return 0;
+    }
 
-    elements_per_proc = N / size; // Calculate number of elements per process
+    if (N > INT32_MAX)
+    {
+        if (rank == 0)
+        {
+            printf("Use -stream for more than %d elements.\n", INT32_MAX);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Calculate the number of elements of each process; the first N % size get one more
+    int *counts = (int *)malloc(size * sizeof(int));
+    int *displs = (int *)malloc(size * sizeof(int));
+    for (i = 0; i < size; i++)
+    {
+        displs[i] = (int)rangeStart(N, size, i);
+        counts[i] = (int)rangeStart(N, size, i + 1) - displs[i];
+    }
+    elements_per_proc = counts[rank];
 
     // Master process prepares data
     if (rank == 0)
@@ -53,16 +247,24 @@ int main(int argc, char *argv[])
     sub_data = (int *)malloc(elements_per_proc * sizeof(int));
 
     // Distribute parts of the array to all processes
-    MPI_Scatter(data, elements_per_proc, MPI_INT, sub_data, elements_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(data, counts, displs, MPI_INT, sub_data, elements_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
 
-    // Each process calculates its partial sum
-    for (i = 0; i < elements_per_proc; i++)
+    // Each process calculates its partial sum, and the statistics of its part a chunk at a time
+    double *values = (double *)malloc(CHUNK * sizeof(double));
+    for (int start = 0; start < elements_per_proc; start += CHUNK)
     {
-        local_sum += sub_data[i];
+        int n = elements_per_proc - start < CHUNK ? elements_per_proc - start : CHUNK;
+        for (i = 0; i < n; i++)
+        {
+            values[i] = sub_data[start + i];
+            local_sum += sub_data[start + i];
+        }
+        accumulateStats(&localStats, values, n, low, high);
     }
 
     // Gather all partial sums to the master process and calculate the total sum
     MPI_Reduce(&local_sum, &total_sum, 1, MPI_LONG_LONG_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    reduceStats(&localStats, &totalStats);
 
     // End timing
     endTime = MPI_Wtime();
@@ -71,6 +273,7 @@ int main(int argc, char *argv[])
     if (rank == 0)
     {
         printf("Total sum = %lld\n", total_sum);
+        printStats(&totalStats, low, high);
         printf("Execution time: %f seconds\n", endTime - startTime);
     }
 
@@ -80,11 +283,234 @@ int main(int argc, char *argv[])
         free(data);
     }
     free(sub_data);
+    free(values);
+    free(counts);
+    free(displs);
 
     MPI_Finalize(); // Finalize MPI
     return 0;
 }
 
+// First element of part p of n elements split into parts; the first n % parts parts get one more
+long long rangeStart(long long n, int parts, int p)
+{
+    return p * (n / parts) + (p < n % parts ? p : n % parts);
+}
+
+// Add a value to the sum, sign extended to 128 bits
+void addToSum(WideSum *sum, long long value)
+{
+    uint64_t bits = (uint64_t)value, extension = value < 0 ? 0xFFFFFFFFu : 0;
+    sum->limbs[0] += bits & 0xFFFFFFFFu;
+    sum->limbs[1] += bits >> 32;
+    sum->limbs[2] += extension;
+    sum->limbs[3] += extension;
+    carrySum(sum);
+}
+
+// Propagate the carries of the limbs, modulo 2^128
+void carrySum(WideSum *sum)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        sum->limbs[k + 1] += sum->limbs[k] >> 32;
+        sum->limbs[k] &= 0xFFFFFFFFu;
+    }
+    sum->limbs[3] &= 0xFFFFFFFFu;
+}
+
+// Write the sum in decimal, by long division of its magnitude by 10
+void formatSum(const WideSum *sum, char *text)
+{
+    uint64_t limbs[4];
+    int negative = (sum->limbs[3] >> 31) != 0;
+    uint64_t carry = negative;
+    for (int k = 0; k < 4; k++)
+    {
+        limbs[k] = (negative ? ~sum->limbs[k] & 0xFFFFFFFFu : sum->limbs[k]) + carry; // Two's complement
+        carry = limbs[k] >> 32;
+        limbs[k] &= 0xFFFFFFFFu;
+    }
+
+    char digits[48];
+    int length = 0;
+    do
+    {
+        uint64_t remainder = 0;
+        for (int k = 3; k >= 0; k--)
+        {
+            uint64_t current = remainder << 32 | limbs[k];
+            limbs[k] = current / 10;
+            remainder = current % 10;
+        }
+        digits[length++] = (char)('0' + remainder);
+    } while (limbs[0] != 0 || limbs[1] != 0 || limbs[2] != 0 || limbs[3] != 0);
+
+    if (negative)
+    {
+        *text++ = '-';
+    }
+    while (length > 0)
+    {
+        *text++ = digits[--length];
+    }
+    *text = '\0';
+}
+
+// The rounded sum of a and b, adding its exact rounding error to *error (Knuth's two-sum)
+static inline double twoSum(double a, double b, double *error)
+{
+    double sum = a + b, part = sum - a;
+    *error += (a - (sum - part)) + (b - part);
+    return sum;
+}
+
+// Add the statistics of n <= CHUNK values to stats, in one pass over them. The sums are taken
+// of the values less the first one, so that they stay small and the variance does not lose
+// its digits to the square of the mean; each of the LANES lanes keeps its own partial sums,
+// the plain sum with Kahan's compensation.
+// Rather than incrementing a bin in memory for every value, each lane counts the values at
+// or above the start of every bin with vector compares, which also sends values outside
+// the range to the end bins.
+void accumulateStats(Stats *stats, const double *values, int n, double low, double high)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    double shift = values[0], scale = BINS / (high - low);
+    double sum = 0.0, error = 0.0, squares = 0.0, min = values[0], max = values[0];
+    Stats chunk = {0};
+    int i = 0;
+
+#if defined(__GNUC__)
+    Lanes sums = {0}, errors = {0}, squareSums = {0}, mins = sums + shift, maxes = sums + shift;
+    LaneMasks above[BINS] = {{0}}; // Less the values in bins b..BINS - 1, for b >= 1
+    for (; i + LANES <= n; i += LANES)
+    {
+        Lanes v;
+        memcpy(&v, values + i, sizeof(Lanes));
+        Lanes d = v - shift;
+        Lanes y = d - errors, s = sums + y; // errors: what each lane's last addition dropped, negated
+        errors = (s - sums) - y;
+        sums = s;
+        squareSums += d * d;
+        mins = BLEND(v < mins, v, mins);
+        maxes = BLEND(v > maxes, v, maxes);
+
+        Lanes t = (v - low) * scale; // Bin of each value, as a fraction
+#pragma GCC unroll 16 // One compare per bin, so that the counts stay in registers at -O2
+        for (int b = 1; b < BINS; b++)
+        {
+            above[b] += (t >= (double)b); // Compares give -1 where true
+        }
+    }
+    for (int k = 0; k < LANES; k++)
+    {
+        sum = twoSum(sum, sums[k], &error);
+        error -= errors[k];
+        squares += squareSums[k];
+        min = mins[k] < min ? mins[k] : min;
+        max = maxes[k] > max ? maxes[k] : max;
+        for (int b = 0; b < BINS; b++)
+        {
+            long long inOrAbove = b == 0 ? i / LANES : -above[b][k];
+            chunk.histogram[b] += inOrAbove - (b + 1 < BINS ? -above[b + 1][k] : 0);
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        double d = values[i] - shift;
+        double t = (values[i] - low) * scale;
+        sum = twoSum(sum, d, &error);
+        squares += d * d;
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+        chunk.histogram[t < 0.0 ? 0 : t >= BINS ? BINS - 1 : (int)t]++;
+    }
+
+    // shift * n is added exactly: the halves of shift from Veltkamp's split have 26 and 27
+    // bits, and n at most 17, so their products need no rounding
+    double split = shift * 134217729.0, shiftHigh = split - (split - shift), shiftLow = shift - shiftHigh;
+    double total = sum + error; // Of the shifted values, for the moments
+    chunk.count = n;
+    chunk.mean = shift + total / n;
+    chunk.m2 = squares - total * total / n;
+    chunk.sum = twoSum(twoSum(shiftHigh * n, shiftLow * n, &chunk.compensation), sum, &chunk.compensation);
+    chunk.compensation += error;
+    chunk.min = min;
+    chunk.max = max;
+    mergeStats(stats, &chunk);
+}
+
+// Merge the statistics of another set into into: the moments with Chan's update of Welford's,
+// the sums with the exact rounding error of their addition (Knuth's two-sum)
+void mergeStats(Stats *into, const Stats *from)
+{
+    if (from->count == 0)
+    {
+        return;
+    }
+    if (into->count == 0)
+    {
+        *into = *from;
+        return;
+    }
+    double count = (double)into->count + from->count;
+    double delta = from->mean - into->mean;
+    into->mean += delta * (from->count / count);
+    into->m2 += from->m2 + delta * delta * ((double)into->count * from->count / count);
+    into->count += from->count;
+
+    into->compensation += from->compensation;
+    into->sum = twoSum(into->sum, from->sum, &into->compensation);
+
+    into->min = from->min < into->min ? from->min : into->min;
+    into->max = from->max > into->max ? from->max : into->max;
+    for (int b = 0; b < BINS; b++)
+    {
+        into->histogram[b] += from->histogram[b];
+    }
+}
+
+// MPI_Op over arrays of Stats, each sent as one element of a contiguous type of bytes
+void mergeStatsOp(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+    (void)type; // Always the Stats type; the parameter is part of MPI_User_function
+    for (int k = 0; k < *len; k++)
+    {
+        mergeStats((Stats *)inout + k, (const Stats *)in + k);
+    }
+}
+
+// Merge the statistics of all processes on the master process, in one reduction
+void reduceStats(const Stats *local, Stats *total)
+{
+    MPI_Datatype statsType;
+    MPI_Op merge;
+    MPI_Type_contiguous(sizeof(Stats), MPI_BYTE, &statsType);
+    MPI_Type_commit(&statsType);
+    MPI_Op_create(mergeStatsOp, 1, &merge);
+    MPI_Reduce(local, total, 1, statsType, merge, 0, MPI_COMM_WORLD);
+    MPI_Op_free(&merge);
+    MPI_Type_free(&statsType);
+}
+
+void printStats(const Stats *stats, double low, double high)
+{
+    printf("Mean = %.17g\n", stats->mean);
+    printf("Variance = %.17g\n", stats->count > 0 ? stats->m2 / stats->count : 0.0);
+    printf("Compensated sum = %.17g\n", stats->sum + stats->compensation);
+    printf("Min = %.17g, max = %.17g\n", stats->min, stats->max);
+    printf("Histogram of [%.15g, %.15g) in %d bins:", low, high, BINS);
+    for (int b = 0; b < BINS; b++)
+    {
+        printf(" %lld", stats->histogram[b]);
+    }
+    printf("\n");
+}
+
 // a program that calculates the sum of an array of numbers in parallel. The idea is to divide the array into equal parts, distribute these parts among multiple processes, each process calculates the sum of its part, and finally, the partial sums are combined to get the total sum.
 
 // Pseudocode